@@ -0,0 +1,466 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <map>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "zJSON.h"
+
+/*
+Benchmark of zJSON: parse, parse_into, write, write_parallel, write_canonical, write_formatted, lookup, visit, copy and destroy on the generated corpora
+(twitter-like, canada-like numeric, citm-like, deep nesting, long strings, NDJSON) and on the files given in the command line.
+Usage: zJSONbench [-t seconds] [-s scale] [-o results] [-c results] [file.json ...]
+Every operation is repeated for the given time (0.5 s by default), the best run is reported as MB/s of JSON text, ns per
+object of the tree and the number of memory allocations per object. -o saves the results to the file, -c compares the run
+with the saved results and reports the gain (make pgo compares the build with profile against the release build).
+*/
+
+static size_t __allocs__ = 0;
+static volatile size_t __sink__ = 0;
+static FILE* __save__ = NULL;
+static std::map<std::string, double> __baseline__;
+
+void* operator new(size_t n)
+{
+ __atomic_fetch_add(&__allocs__, 1, __ATOMIC_RELAXED);
+ void* p=malloc((n)?(n):(1));
+ if(p == NULL) throw std::bad_alloc();
+ return p;
+};
+
+void* operator new[](size_t n)
+{
+ __atomic_fetch_add(&__allocs__, 1, __ATOMIC_RELAXED);
+ void* p=malloc((n)?(n):(1));
+ if(p == NULL) throw std::bad_alloc();
+ return p;
+};
+
+void operator delete(void* p) throw() { free(p); };
+void operator delete[](void* p) throw() { free(p); };
+void operator delete(void* p, size_t) throw() { free(p); };
+void operator delete[](void* p, size_t) throw() { free(p); };
+
+static double now()
+{
+#ifdef _WIN32
+ LARGE_INTEGER f, c;
+ QueryPerformanceFrequency(&f);
+ QueryPerformanceCounter(&c);
+ return (double) c.QuadPart/(double) f.QuadPart;
+#else
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (double) ts.tv_sec+(double) ts.tv_nsec*1e-9;
+#endif
+};
+
+class bench_random
+{
+ public:
+  bench_random(uint64_t seed): m_state(seed) {};
+  uint64_t next() { m_state=m_state*6364136223846793005ULL+1442695040888963407ULL; return (m_state >> 33); };
+  size_t range(size_t n) { return (size_t) (next() % n); };
+  double number() { return ((double) next()/(double) (1ULL << 31))-1.0; };
+
+ private:
+  uint64_t m_state;
+};
+
+static const char* __words__[] =
+{
+ "json", "parser", "value", "stream", "tree", "node", "array", "object", "string", "number", "speed", "memory", "cache",
+ "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "\xe6\x97\xa5\xe6\x9c\xac", "caf\xc3\xa9", "line\\nbreak", "quote\\\"d", "tab\\t"
+};
+
+static std::string bench_text(bench_random& r, size_t words)
+{
+ std::string ret;
+ for(size_t i=0; i < words; i++)
+ {
+  if(i) ret+=' ';
+  ret+=__words__[r.range(sizeof(__words__)/sizeof(__words__[0]))];
+ }
+ return ret;
+};
+
+static std::string corpus_twitter(size_t scale)
+{
+ bench_random r(1);
+ std::string ret="{\"statuses\":[";
+ for(size_t i=0; i < 100*scale; i++)
+ {
+  if(i) ret+=',';
+  ret+="{\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\",\"id\":"+zJSON::toString((uint64_t) (505874924095815681ULL+i));
+  ret+=",\"id_str\":\"505874924095815681\",\"text\":\""+bench_text(r, 12+r.range(12))+"\",\"truncated\":false";
+  ret+=",\"entities\":{\"hashtags\":[";
+  for(size_t k=0, n=r.range(4); k < n; k++) { if(k) ret+=','; ret+="{\"text\":\""+bench_text(r, 1)+"\",\"indices\":["+zJSON::toString((uint64_t) k*10)+","+zJSON::toString((uint64_t) k*10+7)+"]}"; }
+  ret+="],\"symbols\":[],\"urls\":[],\"user_mentions\":[]}";
+  ret+=",\"user\":{\"id\":"+zJSON::toString((uint64_t) r.next())+",\"name\":\""+bench_text(r, 2)+"\",\"screen_name\":\"user"+zJSON::toString((uint64_t) i)+"\"";
+  ret+=",\"location\":\""+bench_text(r, 1)+"\",\"description\":\""+bench_text(r, 8)+"\",\"url\":null,\"protected\":false";
+  ret+=",\"followers_count\":"+zJSON::toString((uint64_t) r.range(100000))+",\"friends_count\":"+zJSON::toString((uint64_t) r.range(5000));
+  ret+=",\"profile_image_url\":\"http://pbs.twimg.com/profile_images/"+zJSON::toString((uint64_t) r.next())+"/normal.jpeg\",\"verified\":false}";
+  ret+=",\"geo\":null,\"coordinates\":null,\"place\":null,\"retweet_count\":"+zJSON::toString((uint64_t) r.range(1000));
+  ret+=",\"favorite_count\":"+zJSON::toString((uint64_t) r.range(1000))+",\"favorited\":false,\"retweeted\":false,\"lang\":\"en\"}";
+ }
+ ret+="],\"search_metadata\":{\"completed_in\":0.087,\"max_id\":505874924095815681,\"query\":\"%E4%B8%80\",\"count\":100}}";
+ return ret;
+};
+
+static std::string corpus_canada(size_t scale)
+{
+ bench_random r(2);
+ std::string ret="{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},";
+ ret+="\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+ for(size_t i=0; i < 10*scale; i++)
+ {
+  if(i) ret+=',';
+  ret+='[';
+  for(size_t k=0; k < 500; k++)
+  {
+   if(k) ret+=',';
+   ret+='['+zJSON::toString(-65.0+r.number()*20.0)+','+zJSON::toString(45.0+r.number()*10.0)+']';
+  }
+  ret+=']';
+ }
+ ret+="]}}]}";
+ return ret;
+};
+
+static std::string corpus_citm(size_t scale)
+{
+ bench_random r(3);
+ std::string ret="{\"areaNames\":{";
+ for(size_t i=0; i < 20*scale; i++) { if(i) ret+=','; ret+="\"2052"+zJSON::toString((uint64_t) i)+"\":\""+bench_text(r, 2)+"\""; }
+ ret+="},\"events\":{";
+ for(size_t i=0; i < 200*scale; i++)
+ {
+  if(i) ret+=',';
+  ret+="\"1389"+zJSON::toString((uint64_t) i)+"\":{\"description\":null,\"id\":"+zJSON::toString((uint64_t) (138586341+i));
+  ret+=",\"logo\":\"/images/UE0AAAAACEKo6QAAAAZDSVRN\",\"name\":\""+bench_text(r, 3)+"\",\"subTopicIds\":[";
+  for(size_t k=0, n=1+r.range(4); k < n; k++) { if(k) ret+=','; ret+=zJSON::toString((uint64_t) (337184262+r.range(100))); }
+  ret+="],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":[324846099,107888604]}";
+ }
+ ret+="},\"performances\":[";
+ for(size_t i=0; i < 200*scale; i++)
+ {
+  if(i) ret+=',';
+  ret+="{\"eventId\":"+zJSON::toString((uint64_t) (138586341+i))+",\"id\":"+zJSON::toString((uint64_t) (339887544+i))+",\"logo\":null,\"name\":null,\"prices\":[";
+  for(size_t k=0, n=2+r.range(4); k < n; k++) { if(k) ret+=','; ret+="{\"amount\":"+zJSON::toString((uint64_t) (9000+r.range(100)*10))+",\"audienceSubCategoryId\":337100890,\"seatCategoryId\":"+zJSON::toString((uint64_t) (338937295+k))+"}"; }
+  ret+="],\"seatCategories\":[{\"areas\":[{\"areaId\":205705999,\"blockIds\":[]},{\"areaId\":205705998,\"blockIds\":[]}],\"seatCategoryId\":338937295}]";
+  ret+=",\"seatMapImage\":null,\"start\":"+zJSON::toString((uint64_t) (1372615200000ULL+i*86400000ULL))+",\"venueCode\":\"PLEYEL_PLEYEL\"}";
+ }
+ ret+="]}";
+ return ret;
+};
+
+static std::string corpus_deep(size_t scale)
+{
+ size_t n=1000*scale;
+ std::string ret;
+ for(size_t i=0; i < n; i++) ret+=(i & 1)?("{\"k\":"):("[1,");
+ ret+="null";
+ for(size_t i=n; i > 0; i--) ret+=((i-1) & 1)?("}"):("]");
+ return ret;
+};
+
+static std::string corpus_strings(size_t scale)
+{
+ bench_random r(5);
+ std::string ret="[";
+ for(size_t i=0; i < 4*scale; i++)
+ {
+  if(i) ret+=',';
+  ret+='\"';
+  ret+=bench_text(r, 40000);
+  ret+='\"';
+ }
+ ret+=']';
+ return ret;
+};
+
+static std::string corpus_ndjson(size_t scale)
+{
+ bench_random r(6);
+ std::string ret;
+ for(size_t i=0; i < 2000*scale; i++)
+ {
+  ret+="{\"ts\":"+zJSON::toString((uint64_t) (1700000000000ULL+i))+",\"level\":\""+((r.range(4))?("info"):("error"))+"\",\"msg\":\""+bench_text(r, 6);
+  ret+="\",\"latency\":"+zJSON::toString(r.number()*100.0+100.0)+",\"tags\":[\"a\",\"b\"],\"ok\":"+((r.range(2))?("true"):("false"))+"}\n";
+ }
+ return ret;
+};
+
+struct bench_corpus
+{
+ std::string name;
+ std::string text;
+ bool ndjson;
+};
+
+struct bench_result
+{
+ double seconds;
+ size_t allocs;
+};
+
+static size_t count_nodes(const zJSON* root)
+{
+ size_t ret=0;
+ std::vector<const zJSON*> stack(1, root);
+ while(stack.size())
+ {
+  const zJSON* p=stack.back();
+  stack.pop_back();
+  ++ret;
+  for(size_t i=0, n=p->size(); i < n; i++) stack.push_back(p->at(i));
+ }
+ return ret;
+};
+
+static bool parse_corpus(const bench_corpus& c, std::vector<zJSON*>& ret)
+{
+ if(!c.ndjson)
+ {
+  zJSON* p=zJSON::parse(c.text);
+  if(p == NULL) return false;
+  ret.push_back(p);
+  return true;
+ }
+ size_t pos=0, res_pos=0, len=c.text.size();
+ while(pos < len)
+ {
+  if(c.text[pos] == '\n' || c.text[pos] == '\r') { ++pos; continue; }
+  zJSON* p=zJSON::parse(c.text, pos, res_pos);
+  if(p == NULL) return false;
+  ret.push_back(p);
+  pos=res_pos;
+ }
+ return true;
+};
+
+static bool reparse_corpus(const bench_corpus& c, std::vector<zJSON*>& docs)
+{
+ if(!c.ndjson) return zJSON::parse_into(*docs[0], c.text);
+ size_t pos=0, res_pos=0, len=c.text.size(), n=0;
+ zJSON::zErrorJSON err;
+ while(pos < len)
+ {
+  if(c.text[pos] == '\n' || c.text[pos] == '\r') { ++pos; continue; }
+  if(n >= docs.size() || !zJSON::parse_into(*docs[n++], c.text, pos, res_pos, err)) return false;
+  pos=res_pos;
+ }
+ return true;
+};
+
+static void destroy(std::vector<zJSON*>& docs)
+{
+ for(size_t i=0; i < docs.size(); i++) delete docs[i];
+ docs.clear();
+};
+
+enum { BENCH_PARSE=0, BENCH_PARSE_INTO, BENCH_WRITE, BENCH_WRITE_PARALLEL, BENCH_WRITE_CANONICAL, BENCH_WRITE_FORMATTED, BENCH_LOOKUP, BENCH_VISIT, BENCH_COPY, BENCH_DESTROY };
+
+static const char* __bench_names__[] = { "parse", "parse_into", "write", "write_parallel", "write_canonical", "write_formatted", "lookup", "visit", "copy", "destroy" };
+
+static size_t lookup(const std::vector<zJSON*>& docs)
+{
+ size_t ret=0;
+ std::vector<const zJSON*> stack;
+ for(size_t d=0; d < docs.size(); d++)
+ {
+  stack.push_back(docs[d]);
+  while(stack.size())
+  {
+   const zJSON* p=stack.back();
+   stack.pop_back();
+   size_t n=p->size();
+   bool node=(p->type() == zJSON::JSON_NODE);
+   for(size_t i=0; i < n; i++)
+   {
+    const zJSON* c=p->at(i);
+    if(node && p->search(c->name()) != NULL) ++ret;
+    if(c->size()) stack.push_back(c);
+   }
+  }
+ }
+ return ret;
+};
+
+class bench_visitor: public zJSON::zVisitorJSON
+{
+ public:
+  bench_visitor(): nodes(0), sum(0.0) {};
+
+  bool enter(const zJSON& p, size_t depth)
+  {
+   ++nodes;
+   if(p.type() == zJSON::JSON_INTEGER || p.type() == zJSON::JSON_NUMBER) sum+=p.as_number();
+   return true;
+  };
+
+  size_t nodes;
+  double sum;
+};
+
+static size_t visit(const std::vector<zJSON*>& docs)
+{
+ bench_visitor v;
+ for(size_t d=0; d < docs.size(); d++) docs[d]->visit(v);
+ return v.nodes+(size_t) (v.sum != 0.0);
+};
+
+static bool run_once(int op, const bench_corpus& c, bench_result& ret)
+{
+ std::vector<zJSON*> docs, copies;
+ std::string out;
+ if(op != BENCH_PARSE && !parse_corpus(c, docs)) return false;
+ if(op == BENCH_WRITE || op == BENCH_WRITE_PARALLEL || op == BENCH_WRITE_CANONICAL || op == BENCH_WRITE_FORMATTED) out.reserve(c.text.size()*4);
+ size_t allocs=__atomic_load_n(&__allocs__, __ATOMIC_RELAXED);
+ double t=now();
+ switch(op)
+ {
+  case BENCH_PARSE: { if(!parse_corpus(c, docs)) return false; break; }
+  case BENCH_PARSE_INTO: { if(!reparse_corpus(c, docs)) return false; break; }
+  case BENCH_WRITE: { for(size_t i=0; i < docs.size(); i++) docs[i]->write(out); break; }
+  case BENCH_WRITE_PARALLEL: { for(size_t i=0; i < docs.size(); i++) docs[i]->write_parallel(out); break; }
+  case BENCH_WRITE_CANONICAL: { for(size_t i=0; i < docs.size(); i++) docs[i]->write_canonical(out); break; }
+  case BENCH_WRITE_FORMATTED: { for(size_t i=0; i < docs.size(); i++) docs[i]->write_formatted(out); break; }
+  case BENCH_LOOKUP: { __sink__+=lookup(docs); break; }
+  case BENCH_VISIT: { __sink__+=visit(docs); break; }
+  case BENCH_COPY: { for(size_t i=0; i < docs.size(); i++) copies.push_back(new zJSON(*docs[i])); break; }
+  case BENCH_DESTROY: { destroy(docs); break; }
+ }
+ ret.seconds=now()-t;
+ ret.allocs=__atomic_load_n(&__allocs__, __ATOMIC_RELAXED)-allocs;
+ destroy(docs);
+ destroy(copies);
+ return true;
+};
+
+static void run(const bench_corpus& c, double seconds)
+{
+ std::vector<zJSON*> docs;
+ if(!parse_corpus(c, docs)) { printf("%-14s parse error\n", c.name.c_str()); return; }
+ size_t nodes=0;
+ for(size_t i=0; i < docs.size(); i++) nodes+=count_nodes(docs[i]);
+ destroy(docs);
+ double mb=(double) c.text.size()/(1024.0*1024.0);
+ for(int op=BENCH_PARSE; op <= BENCH_DESTROY; op++)
+ {
+  bench_result best, r;
+  best.seconds=0.0;
+  best.allocs=0;
+  double start=now();
+  size_t runs=0;
+  while(runs < 3 || (now()-start) < seconds)
+  {
+   if(!run_once(op, c, r)) { printf("%-14s %s failed\n", c.name.c_str(), __bench_names__[op]); return; }
+   if(runs == 0 || r.seconds < best.seconds) best=r;
+   ++runs;
+  }
+  double t=(best.seconds > 0.0)?(best.seconds):(1e-9);
+  if(op == BENCH_PARSE || op == BENCH_PARSE_INTO || op == BENCH_WRITE || op == BENCH_WRITE_PARALLEL || op == BENCH_WRITE_CANONICAL || op == BENCH_WRITE_FORMATTED) printf("%-14s %8.2f %9u  %-16s %10.1f", c.name.c_str(), mb, (unsigned) nodes, __bench_names__[op], mb/t);
+  else printf("%-14s %8.2f %9u  %-16s %10s", c.name.c_str(), mb, (unsigned) nodes, __bench_names__[op], "-");
+  double ns=t*1e9/(double) nodes;
+  printf(" %10.1f %12.2f", ns, (double) best.allocs/(double) nodes);
+  std::string key=c.name+' '+__bench_names__[op];
+  std::map<std::string, double>::const_iterator it=__baseline__.find(key);
+  if(it != __baseline__.end()) printf(" %+7.1f%%", (it->second/ns-1.0)*100.0);
+  printf("\n");
+  if(__save__) fprintf(__save__, "%s %.3f\n", key.c_str(), ns);
+ }
+};
+
+static bool load_baseline(const char* path)
+{
+ FILE* f=fopen(path, "r");
+ if(f == NULL) return false;
+ char name[256], op[64];
+ double ns;
+ while(fscanf(f, "%255s %63s %lf", name, op, &ns) == 3) __baseline__[std::string(name)+' '+op]=ns;
+ fclose(f);
+ return true;
+};
+
+static bool load(const char* path, std::string& ret)
+{
+ FILE* f=fopen(path, "rb");
+ if(f == NULL) return false;
+ char buf[65536];
+ size_t n;
+ while((n=fread(buf, 1, sizeof(buf), f)) > 0) ret.append(buf, n);
+ fclose(f);
+ return true;
+};
+
+int main(int argc, char* argv[])
+{
+ double seconds=0.5;
+ size_t scale=10;
+ std::vector<bench_corpus> corpora;
+ bench_corpus c;
+ for(int i=1; i < argc; i++)
+ {
+  if(strcmp(argv[i], "-t") == 0 && (i+1) < argc) { seconds=atof(argv[++i]); continue; }
+  if(strcmp(argv[i], "-s") == 0 && (i+1) < argc) { scale=(size_t) atoi(argv[++i]); if(scale == 0) scale=1; continue; }
+  if(strcmp(argv[i], "-o") == 0 && (i+1) < argc)
+  {
+   if((__save__=fopen(argv[++i], "w")) == NULL) { fprintf(stderr, "can not write %s\n", argv[i]); return 1; }
+   continue;
+  }
+  if(strcmp(argv[i], "-c") == 0 && (i+1) < argc)
+  {
+   if(!load_baseline(argv[++i])) { fprintf(stderr, "can not read %s\n", argv[i]); return 1; }
+   continue;
+  }
+  c.name=argv[i];
+  c.text.clear();
+  c.ndjson=(c.name.size() > 7 && c.name.compare(c.name.size()-7, 7, ".ndjson") == 0);
+  if(!load(argv[i], c.text)) { fprintf(stderr, "can not read %s\n", argv[i]); return 1; }
+  size_t slash=c.name.find_last_of("/\\");
+  if(slash != std::string::npos) c.name.erase(0, slash+1);
+  std::replace(c.name.begin(), c.name.end(), ' ', '_');
+  corpora.push_back(c);
+ }
+ if(corpora.empty())
+ {
+  c.ndjson=false;
+  c.name="twitter"; c.text=corpus_twitter(scale); corpora.push_back(c);
+  c.name="canada"; c.text=corpus_canada(scale); corpora.push_back(c);
+  c.name="citm"; c.text=corpus_citm(scale); corpora.push_back(c);
+  c.name="deep"; c.text=corpus_deep(scale); corpora.push_back(c);
+  c.name="strings"; c.text=corpus_strings(scale); corpora.push_back(c);
+  c.name="ndjson"; c.text=corpus_ndjson(scale); c.ndjson=true; corpora.push_back(c);
+ }
+ printf("%-14s %8s %9s  %-16s %10s %10s %12s", "corpus", "MB", "objects", "operation", "MB/s", "ns/object", "allocs/object");
+ printf((__baseline__.empty())?("\n"):(" %8s\n"), "gain");
+ for(size_t i=0; i < corpora.size(); i++) run(corpora[i], seconds);
+ if(__save__) fclose(__save__);
+ return 0;
+};
@@ -16,9 +16,30 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <algorithm>
 #include <functional>
 
+#ifdef ZJSON_STATS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ZJSON_UTF8_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define ZJSON_ESCAPE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #include "zJSON.h"
 
 #define PARSE_BLANK(p, len, pos)\
@@ -26,14 +47,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  for(;pos < len;++pos)\
  {\
   if(p[pos] == ' ' || p[pos] == '\t' || p[pos] == '\r' || p[pos] == '\n') continue;\
-  if(p[pos] == '#' || (p[pos] == '/' && p[pos+1] == '/'))\
+  if(!P::comments) break;\
+  if(p[pos] == '#' || (p[pos] == '/' && (pos+1) < len && p[pos+1] == '/'))\
   {\
    for(++pos;pos < len;++pos) { if(p[pos] == '\n') break; }\
    continue;\
   }\
-  if(p[pos] == '/' && p[pos+1] == '*')\
+  if(p[pos] == '/' && (pos+1) < len && p[pos+1] == '*')\
   {\
-   for(pos+=2;pos < len;++pos) { if(p[pos] == '*' && p[pos+1] == '/') { ++pos; break; } }\
+   for(pos+=2;pos < len;++pos) { if(p[pos] == '*' && (pos+1) < len && p[pos+1] == '/') { ++pos; break; } }\
    continue;\
   }\
   break;\
@@ -80,84 +102,68 @@ static bool hex_to_num(size_t& ret, const char* src, size_t len=4)
  return true;
 };
 
-static std::string str_to_json(const char* p, size_t len, size_t start_pos=0, size_t parse_len=std::string::npos)
+static const unsigned char __json_escape__[256] =
 {
- std::string ret;
- if(start_pos >= len) return ret;
- size_t n=parse_len;
- if((start_pos+parse_len) > len) n= len-start_pos;
- p+=start_pos;
- ret.reserve(n*6);
- char c;
- for(size_t i=0; i < n; ++i, ++p)
+ 'u','u','u','u','u','u','u','u','b','t','n','u','f','r','u','u',
+ 'u','u','u','u','u','u','u','u','u','u','u','u','u','u','u','u',
+ 0,0,'\"',0,0,0,0,0,0,0,0,0,0,0,0,'/',
+ 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+ 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+ 0,0,0,0,0,0,0,0,0,0,0,0,'\\',0,0,0,
+ 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+ 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,'u'
+};
+/*
+The second character of the escape sequence of every byte ('u' is \u00XX), 0 if the byte is written as is.
+*/
+
+/*
+escape_scan returns the position of the first byte from pos which is escaped, or len. SSE2 checks 16 bytes at once: the
+control characters are the bytes whose unsigned maximum with 0x1F is 0x1F, the others are compared with '"', '\\', '/' and
+DEL; the tail shorter than 16 bytes is checked by the table.
+*/
+static size_t escape_scan(const unsigned char* s, size_t pos, size_t len)
+{
+#ifdef ZJSON_ESCAPE_SSE2
+ const __m128i control=_mm_set1_epi8(0x1F);
+ const __m128i quote=_mm_set1_epi8('\"');
+ const __m128i backslash=_mm_set1_epi8('\\');
+ const __m128i slash=_mm_set1_epi8('/');
+ const __m128i del=_mm_set1_epi8(0x7F);
+ for(; (pos+16) <= len; pos+=16)
  {
-  c=*p;
-  switch(c)
-  {
-   case '\"': { ret.append("\\\"", 2); break; }
-   case '\\': { ret.append("\\\\", 2); break; }
-   case '/': { ret.append("\\/", 2); break; }
-   case '\b': { ret.append("\\b", 2); break; }
-   case '\f': { ret.append("\\f", 2); break; }
-   case '\n': { ret.append("\\n", 2); break; }
-   case '\r': { ret.append("\\r", 2); break; }
-   case '\t': { ret.append("\\t", 2); break; }
-   case '\x7F': { ret.append("\\u007F", 6); break; }
-   default:
-   {
-    if('\x00' <= c && c < '\x20')
-    {
-     ret.append("\\u00", 4);
-     ret+=__digs__[((unsigned char) c) >> 4];
-     ret+=__digs__[((unsigned char) c) & 0xF];
-     break;
-    }
-    ret+=c;
-    break;
-   }
-  }
+  __m128i v=_mm_loadu_si128((const __m128i*) (s+pos));
+  __m128i m=_mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+  m=_mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+  m=_mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, slash), _mm_cmpeq_epi8(v, del)));
+  int bits=_mm_movemask_epi8(m);
+  if(bits) return pos+__builtin_ctz(bits);
  }
- return ret;
+#endif
+ for(; pos < len && __json_escape__[s[pos]] == 0; ++pos);
+ return pos;
 };
 
-static std::string str_to_json_formatted(const char* p, size_t len, size_t start_pos=0, size_t parse_len=std::string::npos)
+static void json_escape(std::string& ret, const char* p, size_t len)
 {
- std::string ret;
- if(start_pos >= len) return ret;
- size_t n=parse_len;
- if((start_pos+parse_len) > len) n= len-start_pos;
- p+=start_pos;
- ret.reserve(n*6);
- char c;
- for(size_t i=0; i < n; ++i, ++p)
+ const unsigned char* s=(const unsigned char*) p;
+ size_t run=0;
+ unsigned char c;
+ for(size_t i=escape_scan(s, 0, len); i < len; i=escape_scan(s, i+1, len))
  {
-  c=*p;
-  switch(c)
+  c=__json_escape__[s[i]];
+  ret.append(p+run, i-run);
+  run=i+1;
+  ret+='\\';
+  ret+=(char) c;
+  if(c == 'u')
   {
-   case '\"': { ret.append("\\\"", 2); break; }
-   case '\\': { ret.append("\\\\", 2); break; }
-   case '/': { ret.append("\\/", 2); break; }
-   case '\b': { ret.append("\\b", 2); break; }
-   case '\f': { ret.append("\\f", 2); break; }
-   case '\n': { ret+=c; break; }
-   case '\r': { ret+=c; break; }
-   case '\t': { ret+=c; break; }
-   case '\x7F': { ret.append("\\u007F", 6); break; }
-   default:
-   {
-    if('\x00' <= c && c < '\x20')
-    {
-     ret.append("\\u00", 4);
-     ret+=__digs__[((unsigned char) c) >> 4];
-     ret+=__digs__[((unsigned char) c) & 0xF];
-     break;
-    }
-    ret+=c;
-    break;
-   }
+   ret.append("00", 2);
+   ret+=__digs__[s[i] >> 4];
+   ret+=__digs__[s[i] & 0xF];
   }
  }
- return ret;
+ ret.append(p+run, len-run);
 };
 
 static bool json_to_str(std::string& ret, const char* p, size_t len, size_t start_pos=0, size_t parse_len=std::string::npos)
@@ -236,7 +242,7 @@ static bool json_to_str(std::string& ret, const char* p, size_t len, size_t star
  return true;
 };
 
-static size_t read_string(const char* p, size_t len, size_t start_pos)
+template <class P> static size_t read_string(const char* p, size_t len, size_t start_pos)
 {
  if(start_pos >= len || p[start_pos] != '\"') return std::string::npos;
  size_t n= len-start_pos-1;
@@ -244,195 +250,1001 @@ static size_t read_string(const char* p, size_t len, size_t start_pos)
  for(size_t i=0; i < n; ++i, ++p)
  {
   if(*p == '\"') return (start_pos+1+i);
-  if(*p == '\\') { ++i; ++p; }
+  if(!P::relaxed && ((unsigned char) *p) < 0x20) return std::string::npos;
+  if(*p == '\\')
+  {
+   if(!P::relaxed && (i+1) < n)
+   {
+    size_t u;
+    switch(p[1])
+    {
+     case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': { break; }
+     case 'u': { if((i+5) < n && hex_to_num(u, p+2)) break; }
+     default: { return std::string::npos; }
+    }
+   }
+   ++i; ++p;
+  }
  }
  return std::string::npos;
 };
 
-static void parse_blank(const char* p, size_t len, size_t& pos)
+static size_t utf8_error(const unsigned char* p, size_t len)
 {
- for(;pos < len;++pos)
+ size_t i=0;
+ while(i < len)
  {
-  if(p[pos] == ' ' || p[pos] == '\t' || p[pos] == '\r' || p[pos] == '\n') continue;
-  if(p[pos] == '#' || (p[pos] == '/' && p[pos+1] == '/'))
-  {
-   for(++pos;pos < len;++pos) { if(p[pos] == '\n') break; }
-   continue;
-  }
-  if(p[pos] == '/' && p[pos+1] == '*')
+  unsigned char c=p[i];
+  if(c < 0x80) { ++i; continue; }
+  size_t n;
+  unsigned char lo=0x80, hi=0xBF;
+  if(c >= 0xC2 && c <= 0xDF) n=1;
+  else if(c == 0xE0) { n=2; lo=0xA0; }
+  else if(c == 0xED) { n=2; hi=0x9F; }
+  else if(c >= 0xE1 && c <= 0xEF) n=2;
+  else if(c == 0xF0) { n=3; lo=0x90; }
+  else if(c == 0xF4) { n=3; hi=0x8F; }
+  else if(c >= 0xF1 && c <= 0xF3) n=3;
+  else return i;
+  if((len-i) <= n || p[i+1] < lo || p[i+1] > hi) return i;
+  for(size_t k=2; k <= n; ++k) { if((p[i+k] & 0xC0) != 0x80) return i; }
+  i+=(n+1);
+ }
+ return std::string::npos;
+};
+
+#ifdef ZJSON_UTF8_SSSE3
+/*
+Keiser and Lemire: the error of every pair of adjacent bytes is found by three lookups of 16-byte tables (high nibble of the
+first byte, low nibble of the first byte, high nibble of the second byte), the missing or excessive continuation bytes of 3 and
+4 byte sequences are found by the saturated subtraction. The code is compiled for SSSE3 and is selected at run time.
+*/
+
+enum
+{
+ UTF8_TOO_SHORT=1<<0, UTF8_TOO_LONG=1<<1, UTF8_OVERLONG_3=1<<2, UTF8_TOO_LARGE=1<<3,
+ UTF8_SURROGATE=1<<4, UTF8_OVERLONG_2=1<<5, UTF8_TOO_LARGE_1000=1<<6, UTF8_OVERLONG_4=1<<6, UTF8_TWO_CONTS=1<<7,
+ UTF8_CARRY=UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS
+};
+
+static const unsigned char __utf8_byte_1_high__[16] =
+{
+ UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+ UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+ UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+ UTF8_TOO_SHORT,
+ UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+ UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const unsigned char __utf8_byte_1_low__[16] =
+{
+ UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+ UTF8_CARRY | UTF8_OVERLONG_2,
+ UTF8_CARRY,
+ UTF8_CARRY,
+ UTF8_CARRY | UTF8_TOO_LARGE,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+ UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const unsigned char __utf8_byte_2_high__[16] =
+{
+ UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+ UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+ UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+ UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+ UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+ UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+static const unsigned char __utf8_incomplete__[16] =
+{ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0-1, 0xE0-1, 0xC0-1 };
+
+__attribute__((target("ssse3"))) static bool utf8_valid_ssse3(const unsigned char* p, size_t len)
+{
+ const __m128i low=_mm_set1_epi8(0x0F);
+ const __m128i t1h=_mm_loadu_si128((const __m128i*) __utf8_byte_1_high__);
+ const __m128i t1l=_mm_loadu_si128((const __m128i*) __utf8_byte_1_low__);
+ const __m128i t2h=_mm_loadu_si128((const __m128i*) __utf8_byte_2_high__);
+ const __m128i max=_mm_loadu_si128((const __m128i*) __utf8_incomplete__);
+ __m128i error=_mm_setzero_si128();
+ __m128i prev=_mm_setzero_si128();
+ __m128i incomplete=_mm_setzero_si128();
+ unsigned char tail[16];
+ for(size_t i=0; i < len; i+=16)
+ {
+  __m128i in;
+  if((len-i) >= 16) in=_mm_loadu_si128((const __m128i*) (p+i));
+  else
   {
-   for(pos+=2;pos < len;++pos) { if(p[pos] == '*' && p[pos+1] == '/') { ++pos; break; } }
-   continue;
+   memset(tail, 0, sizeof(tail));
+   memcpy(tail, p+i, len-i);
+   in=_mm_loadu_si128((const __m128i*) tail);
   }
-  break;
+  if(_mm_movemask_epi8(in) == 0) { error=_mm_or_si128(error, incomplete); prev=in; incomplete=_mm_setzero_si128(); continue; }
+  __m128i prev1=_mm_alignr_epi8(in, prev, 15);
+  __m128i sc=_mm_and_si128(_mm_and_si128(
+   _mm_shuffle_epi8(t1h, _mm_and_si128(_mm_srli_epi16(prev1, 4), low)),
+   _mm_shuffle_epi8(t1l, _mm_and_si128(prev1, low))),
+   _mm_shuffle_epi8(t2h, _mm_and_si128(_mm_srli_epi16(in, 4), low)));
+  __m128i third=_mm_subs_epu8(_mm_alignr_epi8(in, prev, 14), _mm_set1_epi8((char) (0xE0-0x80)));
+  __m128i fourth=_mm_subs_epu8(_mm_alignr_epi8(in, prev, 13), _mm_set1_epi8((char) (0xF0-0x80)));
+  __m128i must=_mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char) 0x80));
+  error=_mm_or_si128(error, _mm_xor_si128(must, sc));
+  incomplete=_mm_subs_epu8(in, max);
+  prev=in;
+ }
+ error=_mm_or_si128(error, incomplete);
+ return (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF);
+};
+
+static bool utf8_has_ssse3()
+{
+ static int ret=-1;
+ if(ret < 0) ret=(__builtin_cpu_supports("ssse3"))?(1):(0);
+ return ret;
+};
+#endif
+
+static size_t check_utf8(const char* src, size_t len)
+{
+ const unsigned char* p=(const unsigned char*) src;
+ size_t i=0;
+ uint64_t w;
+ for(; (i+8) <= len; i+=8) { memcpy(&w, p+i, 8); if(w & 0x8080808080808080ULL) break; }
+ for(; i < len; ++i) { if(p[i] >= 0x80) break; }
+ if(i == len) return std::string::npos;
+#ifdef ZJSON_UTF8_SSSE3
+ if((len-i) >= 16 && utf8_has_ssse3())
+ {
+  if(utf8_valid_ssse3(p+i, len-i)) return std::string::npos;
  }
- if(pos > len) pos=len;
+#endif
+ size_t n=utf8_error(p+i, len-i);
+ return (n == std::string::npos)?(n):(i+n);
 };
 
-static zJSON* parse_json(const char* p, size_t len, size_t& pos);
+template <class P> static void parse_blank(const char* p, size_t len, size_t& pos)
+{
+ PARSE_BLANK(p, len, pos)
+};
 
-static bool parse_name(std::string& ret, const char* p, size_t len, size_t& pos)
+template <class P> static bool parse_name(std::string& ret, const char* p, size_t len, size_t& pos)
 {
- size_t n=read_string(p, len, pos);
+ size_t n=read_string<P>(p, len, pos);
  if(n == std::string::npos) return false;
  size_t l=(n+1);
  PARSE_BLANK(p, len, l)
- if(p[l] != ':') return false;
+ if(l >= len || p[l] != ':') return false;
  json_to_str(ret, p, len, pos+1, n-pos-1);
  pos=(l+1);
  return true;
 };
 
-static zJSON* parse_null_bool(const char* p, size_t& pos, const std::string& json_name)
+static int read_null_bool(const char* p, size_t len, size_t& pos, bool& ret)
 {
+ size_t n=len-pos;
  p+=pos;
- if(p[0] == 'n' && p[1] == 'u' && p[2] == 'l' && p[3] == 'l') { pos+=4; return new zJSON(zJSON::JSON_NULL, json_name); }
- if(p[0] == 't' && p[1] == 'r' && p[2] == 'u' && p[3] == 'e') { pos+=4; return new zJSON(json_name, true); }
- if(p[0] == 'f' && p[1] == 'a' && p[2] == 'l' && p[3] == 's' && p[4] == 'e') { pos+=5; return new zJSON(json_name, false); }
- return NULL;
+ if(n >= 4 && p[0] == 'n' && p[1] == 'u' && p[2] == 'l' && p[3] == 'l') { pos+=4; return zJSON::JSON_NULL; }
+ if(n >= 4 && p[0] == 't' && p[1] == 'r' && p[2] == 'u' && p[3] == 'e') { pos+=4; ret=true; return zJSON::JSON_BOOLEAN; }
+ if(n >= 5 && p[0] == 'f' && p[1] == 'a' && p[2] == 'l' && p[3] == 's' && p[4] == 'e') { pos+=5; ret=false; return zJSON::JSON_BOOLEAN; }
+ return -1;
+};
+
+static size_t check_number(const char* p, size_t len, size_t pos)
+{
+ if(pos < len && p[pos] == '-') ++pos;
+ if(pos >= len || p[pos] < '0' || p[pos] > '9') return std::string::npos;
+ if(p[pos] == '0') ++pos;
+ else { for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos); }
+ if(pos < len && p[pos] == '.')
+ {
+  ++pos;
+  if(pos >= len || p[pos] < '0' || p[pos] > '9') return std::string::npos;
+  for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos);
+ }
+ if(pos < len && (p[pos] == 'e' || p[pos] == 'E'))
+ {
+  ++pos;
+  if(pos < len && (p[pos] == '-' || p[pos] == '+')) ++pos;
+  if(pos >= len || p[pos] < '0' || p[pos] > '9') return std::string::npos;
+  for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos);
+ }
+ return pos;
 };
 
-static zJSON* parse_integer_number(const char* p, size_t len, size_t& pos, const std::string& json_name)
+template <class P> static int read_integer_number(const char* p, size_t len, size_t& pos, int64_t& integer, double& number)
 {
  int sign=1;
  int point=0;
  unsigned exponenta=0;
  double multiplier=1.0;
  double ret=0.0;
- p+=pos;
- size_t i=0;
- switch(*p)
+ uint64_t exact=0;
+ bool overflow=false;
+ size_t i=pos;
+ if(i >= len) return -1;
+ switch(p[i])
  {
-  case '-': { sign=-1; }
-  case '+': { ++p; ++i; }
+  case '-': { sign=-1; ++i; break; }
+  case '+': { if(P::sign) { ++i; } break; }
  }
- PARSE_BLANK(p, len, i)
- if(*p < '0' || *p > '9') return NULL;
- for(;;++p, ++i)
+ if(P::sign) { PARSE_BLANK(p, len, i) }
+ if(i >= len || p[i] < '0' || p[i] > '9') return -1;
+ for(;i < len;++i)
  {
-  if(*p == '.') { if(point) { break; } point=1; continue; }
-  if(*p == 'e' || *p == 'E')
+  if(p[i] == '.') { if(point) { break; } point=1; continue; }
+  if(p[i] == 'e' || p[i] == 'E')
   {
    if(point > 1) { break; }
-   switch(*(p+1))
+   switch(((i+1) < len)?(p[i+1]):('\0'))
    {
-    case '-': { point=4; ++p; ++i; break; }
-    case '+': { point=2; ++p; ++i; break; }
+    case '-': { point=4; ++i; break; }
+    case '+': { point=2; ++i; break; }
     default:  { point=2; }
    }
    continue;
   }
-  if(*p < '0' || *p > '9') break;
-  if(point < 2) { ret*=10.; ret+=((unsigned char) *p - '0'); if(point) { multiplier*=10.; } }
-  else { exponenta*=10; exponenta+=((unsigned char) *p - '0'); if(exponenta > 308) return NULL; }
+  if(p[i] < '0' || p[i] > '9') break;
+  if(point < 2) { ret*=10.; ret+=((unsigned char) p[i] - '0'); if(point) { multiplier*=10.; } }
+  else { exponenta*=10; exponenta+=((unsigned char) p[i] - '0'); if(exponenta > 308) return -1; }
+  if(!point && !overflow)
+  {
+   unsigned d=((unsigned char) p[i] - '0');
+   if(exact > (UINT64_MAX-d)/10) overflow=true; else exact=exact*10+d;
+  }
  }
+ if(!P::relaxed && check_number(p, len, pos) != i) return -1;
  if(multiplier != 0.0 && multiplier != 1.) { ret/=multiplier; }
  if(point & 2) { for(size_t j=0; j < exponenta; j++) { ret*=10.; } }
  else if(point & 4) { for(size_t j=0; j < exponenta; j++) { ret/=10.; } }
  ret*=sign;
- pos+=i;
- if(point) return new zJSON(json_name, ret);
- return new zJSON(json_name, (int64_t) ret);
+ pos=i;
+ if(point) { number=ret; return zJSON::JSON_NUMBER; }
+ if(!overflow && exact <= ((uint64_t) INT64_MAX)+((sign < 0)?(1):(0))) { integer=(sign < 0)?((int64_t) (0-exact)):((int64_t) exact); }
+ else integer=(sign < 0)?(INT64_MIN):(INT64_MAX);
+ return zJSON::JSON_INTEGER;
 };
 
-static zJSON* parse_string(const char* p, size_t len, size_t& pos, const std::string& json_name)
+/*
+read_raw_number finds the end of the number written in the strict grammar which read_integer_number accepts with the same
+end, the number is not converted. Returns JSON_INTEGER or JSON_NUMBER, or -1 if the number must be read by
+read_integer_number (the relaxed forms and the errors).
+*/
+static int read_raw_number(const char* p, size_t len, size_t& pos)
 {
- size_t n=read_string(p, len, pos);
- if(n == std::string::npos) return NULL;
- std::string s;
- json_to_str(s, p, len, pos+1, n-pos-1);
+ size_t n=check_number(p, len, pos);
+ if(n == std::string::npos) return -1;
+ if(n < len && ((p[n] >= '0' && p[n] <= '9') || p[n] == '.' || p[n] == 'e' || p[n] == 'E')) return -1;
+ int ret=zJSON::JSON_INTEGER;
+ for(size_t i=pos; i < n; ++i)
+ {
+  if(p[i] == '.') { ret=zJSON::JSON_NUMBER; continue; }
+  if(p[i] != 'e' && p[i] != 'E') continue;
+  ret=zJSON::JSON_NUMBER;
+  if(p[++i] == '-' || p[i] == '+') ++i;
+  unsigned exponenta=0;
+  for(; i < n; ++i) { exponenta*=10; exponenta+=((unsigned char) p[i] - '0'); if(exponenta > 308) return -1; }
+ }
+ pos=n;
+ return ret;
+};
+
+template <class P> static bool read_string_value(std::string& ret, const char* p, size_t len, size_t& pos)
+{
+ size_t n=read_string<P>(p, len, pos);
+ if(n == std::string::npos) return false;
+ json_to_str(ret, p, len, pos+1, n-pos-1);
  pos=(n+1);
+ if(!P::concatenation) return true;
  for(;;)
  {
-  PARSE_BLANK(p, len, pos)
-  n=read_string(p, len, pos);
+  size_t l=pos;
+  PARSE_BLANK(p, len, l)
+  n=read_string<P>(p, len, l);
   if(n == std::string::npos) break;
-  json_to_str(s, p, len, pos+1, n-pos-1);
+  json_to_str(ret, p, len, l+1, n-l-1);
   pos=(n+1);
  }
- zJSON* ret= new zJSON(json_name, s);
- return ret;
+ return true;
+};
+
+template <class P> static bool parse_separator(const char* p, size_t len, size_t& pos, char end)
+{
+ PARSE_BLANK(p, len, pos)
+ if(pos >= len) return false;
+ if(p[pos] == end) return true;
+ if(p[pos] == ',')
+ {
+  ++pos;
+  PARSE_BLANK(p, len, pos)
+  if(pos < len && p[pos] == end) return (P::trailing_commas);
+  return true;
+ }
+ return (P::relaxed);
+};
+
+static bool set_error(zJSON::zErrorJSON* err, int code, const char* p, size_t len, size_t pos)
+{
+ if(err == NULL || err->code != zJSON::zErrorJSON::ERROR_NONE) return false;
+ if(pos >= len) { code=zJSON::zErrorJSON::ERROR_EOF; pos=len; }
+ err->code=code;
+ err->offset=pos;
+ err->line=1;
+ err->column=1;
+ for(size_t i=0; i < pos; ++i)
+ {
+  if(p[i] == '\n') { ++err->line; err->column=1; }
+  else ++err->column;
+ }
+ err->path.clear();
+ return false;
+};
+
+template <class P> static size_t string_error(const char* p, size_t len, size_t pos)
+{
+ for(++pos; pos < len; ++pos)
+ {
+  if(!P::relaxed && ((unsigned char) p[pos]) < 0x20) return pos;
+  if(p[pos] != '\\') continue;
+  if(P::relaxed || (pos+1) >= len) { ++pos; continue; }
+  size_t u;
+  switch(p[pos+1])
+  {
+   case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': { ++pos; continue; }
+   case 'u':
+   {
+    if(!hex_to_num(u, p+pos+2, ((pos+5) < len)?(4):(len-pos-2))) break;
+    if((pos+5) >= len) return len;
+    ++pos;
+    continue;
+   }
+  }
+  return pos;
+ }
+ return len;
+};
+
+template <class P> static bool number_cut(const char* p, size_t len, size_t pos)
+{
+ if(pos < len && (p[pos] == '-' || (P::sign && p[pos] == '+'))) ++pos;
+ if(P::sign) { PARSE_BLANK(p, len, pos) }
+ if(P::comments && (pos+1) == len && p[pos] == '/') return true;
+ if(P::relaxed || pos >= len) return (pos >= len);
+ if(p[pos] == '0') { ++pos; if(pos < len && p[pos] >= '0' && p[pos] <= '9') return false; }
+ else { for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos); }
+ if(pos < len && p[pos] == '.')
+ {
+  if(++pos >= len) return true;
+  if(p[pos] < '0' || p[pos] > '9') return false;
+  for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos);
+ }
+ if(pos < len && (p[pos] == 'e' || p[pos] == 'E'))
+ {
+  ++pos;
+  if(pos < len && (p[pos] == '-' || p[pos] == '+')) ++pos;
+  if(pos >= len) return true;
+  if(p[pos] < '0' || p[pos] > '9') return false;
+  unsigned exponenta=0;
+  for(;pos < len && p[pos] >= '0' && p[pos] <= '9';++pos) { exponenta*=10; exponenta+=((unsigned char) p[pos] - '0'); if(exponenta > 308) return false; }
+ }
+ return (pos >= len);
+};
+
+/*
+cut_error returns the end of the text instead of the error position at if the value which starts at at is cut by the end of
+the text (the prefix of null, true, false or of the number, or '/' which may start the comment), so the error is reported as
+ERROR_EOF and the text which is read by parts (zReaderJSON) is known to need more bytes.
+*/
+template <class P> static size_t cut_error(int code, const char* p, size_t len, size_t at)
+{
+ if(at >= len) return at;
+ if(code == zJSON::zErrorJSON::ERROR_NUMBER) return (number_cut<P>(p, len, at))?(len):(at);
+ if(code != zJSON::zErrorJSON::ERROR_TOKEN) return at;
+ if(P::comments && p[at] == '/' && (at+1) == len) return len;
+ static const char* __literals__[3]={ "null", "true", "false" };
+ size_t n=len-at;
+ for(size_t i=0; i < 3; i++)
+ {
+  if(n < strlen(__literals__[i]) && memcmp(p+at, __literals__[i], n) == 0) return len;
+ }
+ return at;
+};
+
+enum { JSON_CLASS_ERROR=0, JSON_CLASS_LITERAL, JSON_CLASS_STRING, JSON_CLASS_ARRAY, JSON_CLASS_NODE, JSON_CLASS_NUMBER };
+
+#ifdef ZJSON_STATS
+/*
+The statistics of the current call and of the thread. Nested calls are counted as a part of the outer call.
+*/
+#if __cplusplus >= 201103L
+#define ZJSON_THREAD thread_local
+#else
+#define ZJSON_THREAD __thread
+#endif
+
+static ZJSON_THREAD zJSON::zStatsJSON __stats_call__;
+static ZJSON_THREAD zJSON::zStatsJSON __stats_thread__;
+static ZJSON_THREAD size_t __stats_level__;
+static zJSON::zStatsHookJSON __stats_hook__ = NULL;
+static void* __stats_arg__ = NULL;
+
+zJSON::zStatsJSON& zjson_stats_call() { return __stats_call__; };
+
+static uint64_t stats_clock()
+{
+#ifdef _WIN32
+ LARGE_INTEGER f, c;
+ QueryPerformanceFrequency(&f);
+ QueryPerformanceCounter(&c);
+ return (uint64_t) ((double) c.QuadPart*1e9/(double) f.QuadPart);
+#else
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (uint64_t) ts.tv_sec*1000000000ULL+(uint64_t) ts.tv_nsec;
+#endif
+};
+
+uint64_t zjson_stats_begin()
+{
+ if(__stats_level__++) return 0;
+ __stats_call__.clear();
+ return stats_clock();
+};
+
+void zjson_stats_end(int phase, uint64_t start)
+{
+ if(--__stats_level__) return;
+ __stats_call__.time[phase]=stats_clock()-start;
+ __stats_call__.calls[phase]=1;
+ __stats_thread__.add(__stats_call__);
+ if(__stats_hook__) __stats_hook__(phase, __stats_call__, __stats_arg__);
+};
+
+class zjson_stats_scope
+{
+ public:
+  zjson_stats_scope(int phase): m_phase(phase), m_start(zjson_stats_begin()) {};
+  ~zjson_stats_scope() { zjson_stats_end(m_phase, m_start); };
+
+ private:
+  int m_phase;
+  uint64_t m_start;
+};
+
+#define ZJSON_STATS_SCOPE(phase) zjson_stats_scope __stats_scope__(phase);
+#define ZJSON_STATS_NODE(json_type) ++__stats_call__.nodes[json_type];
+#define ZJSON_STATS_DEPTH(depth) { if((depth) > __stats_call__.max_depth) __stats_call__.max_depth=(depth); }
+#define ZJSON_STATS_BYTES(n) __stats_call__.bytes+=(n);
+#define ZJSON_STATS_ALLOC(size) { ++__stats_call__.allocations; __stats_call__.allocated+=(size); }
+#else
+#define ZJSON_STATS_SCOPE(phase)
+#define ZJSON_STATS_NODE(json_type)
+#define ZJSON_STATS_DEPTH(depth)
+#define ZJSON_STATS_BYTES(n)
+#define ZJSON_STATS_ALLOC(size)
+#endif
+
+static const unsigned char __json_class__[256] =
+{
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 5, 0, 5, 0, 0,
+ 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0,
+ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+struct zjson_frame
+{
+ char end;
+ size_t count;
+ size_t name;
+};
+
+class zjson_stack
+{
+ public:
+  zjson_stack(): m_size(0) { };
+
+  size_t size() const { return m_size; };
+  zjson_frame& operator[](size_t pos) { return (pos < __local_frames__)?(m_local[pos]):(m_more[pos-__local_frames__]); };
+  zjson_frame& top() { return (*this)[m_size-1]; };
+  void push(char end)
+  {
+   if(m_size >= __local_frames__ && (m_size-__local_frames__) >= m_more.size()) m_more.push_back(zjson_frame());
+   zjson_frame& f=(*this)[m_size++];
+   f.end=end;
+   f.count=0;
+   f.name=std::string::npos;
+  };
+  void pop() { --m_size; };
+
+ private:
+  enum { __local_frames__=32 };
+  zjson_frame m_local[__local_frames__];
+  std::vector<zjson_frame> m_more;
+  size_t m_size;
 };
 
-static zJSON* parse_array_node(const char* p, size_t len, size_t& pos, const std::string& json_name)
+template <class P> static int read_name(std::string* ret, const char* p, size_t len, size_t& pos, size_t& at, const zJSON::zOptionJSON& opt, size_t* end=NULL)
 {
- zJSON* ret=NULL;
- switch(p[pos])
+ size_t n=read_string<P>(p, len, pos);
+ if(n == std::string::npos)
  {
-  case '[': { ret= new zJSON(zJSON::JSON_ARRAY, json_name); break; }
-  case '{': { ret= new zJSON(zJSON::JSON_NODE, json_name); break; }
-  default: { return NULL; }
+  if(pos < len && p[pos] == '\"') { at=string_error<P>(p, len, pos); return zJSON::zErrorJSON::ERROR_STRING; }
+  at=pos; return zJSON::zErrorJSON::ERROR_NAME;
  }
- size_t l=pos+1;
+ if((n-pos-1) > opt.max_string) { at=pos; return zJSON::zErrorJSON::ERROR_STRING_LIMIT; }
+ if(opt.utf8 && (at=check_utf8(p+pos+1, n-pos-1)) != std::string::npos) { at+=(pos+1); return zJSON::zErrorJSON::ERROR_UTF8; }
+ size_t l=(n+1);
  PARSE_BLANK(p, len, l)
- if(ret->type() == zJSON::JSON_ARRAY) { if(p[l] == ']') { pos=l+1; return ret; } }
- else if(p[l] == '}') { pos=l+1; return ret; }
- for(zJSON* p_json=parse_json(p, len, l); p_json != NULL; p_json=parse_json(p, len, l))
+ if(l >= len || p[l] != ':') { at=l; return zJSON::zErrorJSON::ERROR_NAME; }
+ if(ret) { ret->clear(); json_to_str(*ret, p, len, pos+1, n-pos-1); }
+ if(end) *end=n;
+ pos=(l+1);
+ return zJSON::zErrorJSON::ERROR_NONE;
+};
+
+template <class P> static int read_value_string(std::string* ret, const char* p, size_t len, size_t& pos, size_t& at, const zJSON::zOptionJSON& opt, size_t* end=NULL)
+{
+ size_t n=read_string<P>(p, len, pos);
+ if(n == std::string::npos) { at=string_error<P>(p, len, pos); return zJSON::zErrorJSON::ERROR_STRING; }
+ size_t size=n-pos-1;
+ if(size > opt.max_string) { at=pos; return zJSON::zErrorJSON::ERROR_STRING_LIMIT; }
+ if(opt.utf8 && (at=check_utf8(p+pos+1, size)) != std::string::npos) { at+=(pos+1); return zJSON::zErrorJSON::ERROR_UTF8; }
+ if(ret) { ret->clear(); json_to_str(*ret, p, len, pos+1, n-pos-1); }
+ if(end) *end=n;
+ pos=(n+1);
+ if(!P::concatenation) return zJSON::zErrorJSON::ERROR_NONE;
+ for(;;)
  {
-  ret->push_back(p_json);
+  size_t l=pos;
   PARSE_BLANK(p, len, l)
-  if(p[l] == ',') 
+  n=read_string<P>(p, len, l);
+  if(n == std::string::npos) break;
+  size+=n-l-1;
+  if(size > opt.max_string) { at=l; return zJSON::zErrorJSON::ERROR_STRING_LIMIT; }
+  if(opt.utf8 && (at=check_utf8(p+l+1, n-l-1)) != std::string::npos) { at+=(l+1); return zJSON::zErrorJSON::ERROR_UTF8; }
+  if(ret) json_to_str(*ret, p, len, l+1, n-l-1);
+  pos=(n+1);
+ }
+ return zJSON::zErrorJSON::ERROR_NONE;
+};
+
+template <class P> static void path_token(std::string& path, std::string& token, char end, size_t count, size_t name, const char* p, size_t len)
+{
+ token.clear();
+ if(end != '}' || name == std::string::npos || !parse_name<P>(token, p, len, name)) token=zJSON::toString((uint64_t) count);
+ path+='/';
+ for(size_t j=0; j < token.size(); ++j)
+ {
+  switch(token[j])
   {
-   ++l;
-   PARSE_BLANK(p, len, l)
-   if(ret->type() == zJSON::JSON_ARRAY) { if(p[l] == ']') { pos=l+1; return ret; } }
-   else if(p[l] == '}') { pos=l+1; return ret; }
-   continue; 
+   case '~': { path.append("~0", 2); break; }
+   case '/': { path.append("~1", 2); break; }
+   default: { path+=token[j]; break; }
   }
-  if(ret->type() == zJSON::JSON_ARRAY) { if(p[l] == ']') { pos=l+1; return ret; } }
-  else if(p[l] == '}') { pos=l+1; return ret; }
  }
- delete ret; return NULL;
 };
 
-static zJSON* parse_json(const char* p, size_t len, size_t& pos)
+template <class P> static void stack_path(zJSON::zErrorJSON* err, zjson_stack& stack, size_t levels, const char* p, size_t len)
 {
- std::string json_name;
- PARSE_BLANK(p, len, pos)
- size_t l=pos;
- parse_name(json_name, p, len, l);
- zJSON* ret=NULL;
- PARSE_BLANK(p, len, l)
- ret=parse_null_bool(p, l, json_name);
- if(ret) { pos=l; return ret; }
- ret=parse_integer_number(p, len, l, json_name);
- if(ret) { pos=l; return ret; }
- ret=parse_string(p, len, l, json_name);
- if(ret) { pos=l; return ret; }
- ret=parse_array_node(p, len, l, json_name);
- if(ret) { pos=l; return ret; }
- return NULL;
+ if(err == NULL) return;
+ std::string token;
+ for(size_t i=0; i < levels; ++i)
+ {
+  zjson_frame& f=stack[i];
+  path_token<P>(err->path, token, f.end, f.count, f.name, p, len);
+ }
 };
 
-void zJSON::zjson_null::write(std::string& ret, const zJSON* const prn) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\":"):"")+"null"; };
+/*
+parse_engine is the iterative parser: the nesting is kept in the explicit stack and every value is dispatched by its first
+byte. The handler H receives the values: name_buffer and string_buffer return the buffers for the names and strings (NULL
+if they are not needed), then one of value_null, value_boolean, value_integer, value_number, value_string, begin and end
+is called for every value (value_raw with the source text of the number instead of value_integer and value_number if
+zOptionJSON::raw_numbers is set).
+*/
+template <class P, class H> static bool parse_engine(H& h, const char* p, size_t len, size_t& pos, const zJSON::zOptionJSON& opt, zJSON::zErrorJSON* err)
+{
+ ZJSON_STATS_SCOPE(H::phase)
+ size_t full=len;
+ if((len-pos) > opt.max_bytes) len=pos+opt.max_bytes;
+ zjson_stack stack;
+ std::string* name_buffer=h.name_buffer();
+ std::string* string_buffer=h.string_buffer();
+ size_t nodes=0;
+ size_t l=pos;
+ size_t at=0;
+ int code=zJSON::zErrorJSON::ERROR_NONE;
+ bool inside=true;
+ int last=JSON_CLASS_ERROR;
+ for(;;)
+ {
+  PARSE_BLANK(p, len, l)
+  if(name_buffer) name_buffer->clear();
+  if(stack.size())
+  {
+   zjson_frame& f=stack.top();
+   if(f.count >= opt.max_elements) { code=zJSON::zErrorJSON::ERROR_ELEMENTS_LIMIT; at=l; inside=false; break; }
+   if(P::relaxed || f.end == '}')
+   {
+    size_t n=l;
+    int res=read_name<P>(name_buffer, p, len, n, at, opt);
+    if(res == zJSON::zErrorJSON::ERROR_NONE) { f.name=l; l=n; PARSE_BLANK(p, len, l) }
+    else if(!P::relaxed) { code=res; break; }
+    else if(name_buffer) name_buffer->clear();
+   }
+  }
+  else if(P::relaxed)
+  {
+   size_t n=l;
+   if(read_name<P>(name_buffer, p, len, n, at, opt) == zJSON::zErrorJSON::ERROR_NONE) { l=n; PARSE_BLANK(p, len, l) }
+   else if(name_buffer) name_buffer->clear();
+  }
+  if(l >= len) { code=zJSON::zErrorJSON::ERROR_EOF; at=l; break; }
+  if(++nodes > opt.max_nodes) { code=zJSON::zErrorJSON::ERROR_NODES_LIMIT; at=l; break; }
+  last=__json_class__[(unsigned char) p[l]];
+  switch(last)
+  {
+   case JSON_CLASS_LITERAL:
+   {
+    bool b;
+    switch(read_null_bool(p, len, l, b))
+    {
+     case zJSON::JSON_NULL: { h.value_null(); ZJSON_STATS_NODE(zJSON::JSON_NULL) break; }
+     case zJSON::JSON_BOOLEAN: { h.value_boolean(b); ZJSON_STATS_NODE(zJSON::JSON_BOOLEAN) break; }
+     default: { code=zJSON::zErrorJSON::ERROR_TOKEN; at=l; }
+    }
+    break;
+   }
+   case JSON_CLASS_STRING:
+   {
+    code=read_value_string<P>(string_buffer, p, len, l, at, opt);
+    if(code == zJSON::zErrorJSON::ERROR_NONE) { h.value_string(); ZJSON_STATS_NODE(zJSON::JSON_STRING) }
+    break;
+   }
+   case JSON_CLASS_NUMBER:
+   {
+    if(opt.raw_numbers)
+    {
+     size_t n=l;
+     int res=read_raw_number(p, len, n);
+     if(res >= 0) { h.value_raw(p+l, n-l, res); ZJSON_STATS_NODE(res) l=n; break; }
+    }
+    int64_t integer;
+    double number;
+    switch(read_integer_number<P>(p, len, l, integer, number))
+    {
+     case zJSON::JSON_INTEGER: { h.value_integer(integer); ZJSON_STATS_NODE(zJSON::JSON_INTEGER) break; }
+     case zJSON::JSON_NUMBER: { h.value_number(number); ZJSON_STATS_NODE(zJSON::JSON_NUMBER) break; }
+     default: { code=zJSON::zErrorJSON::ERROR_NUMBER; at=l; }
+    }
+    break;
+   }
+   case JSON_CLASS_ARRAY:
+   case JSON_CLASS_NODE:
+   {
+    if(stack.size() >= opt.max_depth) { code=zJSON::zErrorJSON::ERROR_DEPTH; at=l; break; }
+    char end=(last == JSON_CLASS_ARRAY)?(']'):('}');
+    h.begin((last == JSON_CLASS_ARRAY)?(zJSON::JSON_ARRAY):(zJSON::JSON_NODE));
+    stack.push(end);
+    ZJSON_STATS_NODE((last == JSON_CLASS_ARRAY)?(zJSON::JSON_ARRAY):(zJSON::JSON_NODE))
+    ZJSON_STATS_DEPTH(stack.size())
+    ++l;
+    PARSE_BLANK(p, len, l)
+    if(l < len && p[l] == end) { ++l; stack.pop(); h.end(); break; }
+    continue;
+   }
+   default: { code=zJSON::zErrorJSON::ERROR_TOKEN; at=l; }
+  }
+  if(code != zJSON::zErrorJSON::ERROR_NONE) break;
+  for(;;)
+  {
+   if(stack.size() == 0) break;
+   zjson_frame& f=stack.top();
+   if(!parse_separator<P>(p, len, l, f.end))
+   {
+    code=(l < len && p[l] == f.end)?(zJSON::zErrorJSON::ERROR_TOKEN):(zJSON::zErrorJSON::ERROR_SEPARATOR);
+    at=l; inside=false;
+    break;
+   }
+   if(l < len && p[l] == f.end) { ++l; stack.pop(); h.end(); last=JSON_CLASS_ERROR; continue; }
+   ++f.count;
+   f.name=std::string::npos;
+   break;
+  }
+  if(code != zJSON::zErrorJSON::ERROR_NONE || stack.size() == 0) break;
+ }
+ if(code == zJSON::zErrorJSON::ERROR_NONE && last == JSON_CLASS_NUMBER && l == len && len < full) { code=zJSON::zErrorJSON::ERROR_EOF; at=l; }
+ ZJSON_STATS_BYTES(l-pos)
+ if(code == zJSON::zErrorJSON::ERROR_NONE) { pos=l; return true; }
+ if(err)
+ {
+  set_error(err, code, p, len, cut_error<P>(code, p, len, at));
+  if(err->code == zJSON::zErrorJSON::ERROR_EOF && len < full) err->code=zJSON::zErrorJSON::ERROR_BYTES_LIMIT;
+  stack_path<P>(err, stack, (inside)?(stack.size()):(stack.size()-1), p, len);
+ }
+ return false;
+};
 
-void zJSON::zjson_null::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):std::string(level,' '))+"null"; };
+class zjson_null_handler
+{
+ public:
+#ifdef ZJSON_STATS
+  enum { phase=zJSON::zStatsJSON::PHASE_VALIDATE };
+#endif
+  std::string* name_buffer() { return NULL; };
+  std::string* string_buffer() { return NULL; };
+  void value_null() { };
+  void value_boolean(bool) { };
+  void value_integer(int64_t) { };
+  void value_number(double) { };
+  void value_raw(const char*, size_t, int) { };
+  void value_string() { };
+  void begin(int) { };
+  void end() { };
+};
+
+class zjson_builder
+{
+ public:
+#ifdef ZJSON_STATS
+  enum { phase=zJSON::zStatsJSON::PHASE_PARSE };
+#endif
+  zjson_builder(): m_root(NULL), m_current(NULL) { };
+  ~zjson_builder() { delete m_root; };
+
+  std::string* name_buffer() { return &m_name; };
+  std::string* string_buffer() { return &m_string; };
+  void value_null() { add(new zJSON(zJSON::JSON_NULL, m_name)); };
+  void value_boolean(bool value) { add(new zJSON(m_name, value)); };
+  void value_integer(int64_t value) { add(new zJSON(m_name, value)); };
+  void value_number(double value) { add(new zJSON(m_name, value)); };
+  void value_raw(const char* s, size_t n, int json_type) { add(new zJSON(m_name, new zJSON::zjson_raw_number(s, n, json_type))); };
+  void value_string() { zJSON* p=new zJSON(zJSON::JSON_STRING, m_name); p->ptr_string()->swap(m_string); add(p); };
+  void begin(int json_type) { zJSON* p=new zJSON(json_type, m_name); add(p); m_current=p; };
+  void end() { m_current=m_current->m_parent; };
+
+  zJSON* release() { zJSON* ret=m_root; m_root=NULL; m_current=NULL; return ret; };
+
+ private:
+  zJSON* m_root;
+  zJSON* m_current;
+  std::string m_name;
+  std::string m_string;
+
+  void add(zJSON* p)
+  {
+#ifdef ZJSON_STATS
+   allocated(p);
+#endif
+   if(m_current == NULL) { delete m_root; m_root=p; return; }
+   p->m_parent=m_current;
+   std::vector<zJSON*>& v=(m_current->type() == zJSON::JSON_ARRAY)?(static_cast<zJSON::zjson_array*>(m_current->m_value)->value):(static_cast<zJSON::zjson_node*>(m_current->m_value)->value);
+#ifdef ZJSON_STATS
+   size_t capacity=v.capacity();
+   v.push_back(p);
+   if(v.capacity() != capacity) ZJSON_STATS_ALLOC(v.capacity()*sizeof(zJSON*))
+#else
+   v.push_back(p);
+#endif
+  };
+
+#ifdef ZJSON_STATS
+ public:
+  static void allocated(const zJSON* p)
+  {
+   static const size_t sso=std::string().capacity();
+   ZJSON_STATS_ALLOC(sizeof(zJSON))
+   switch(p->type())
+   {
+    case zJSON::JSON_NULL: { ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_null)) break; }
+    case zJSON::JSON_BOOLEAN: { ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_bool)) break; }
+    case zJSON::JSON_INTEGER:
+    case zJSON::JSON_NUMBER:
+    {
+     const std::string* raw=p->ptr_raw();
+     if(raw)
+     {
+      ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_raw_number))
+      if(raw->capacity() > sso) ZJSON_STATS_ALLOC(raw->capacity()+1)
+     }
+     else if(p->type() == zJSON::JSON_INTEGER) ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_integer))
+     else ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_number))
+     break;
+    }
+    case zJSON::JSON_STRING:
+    {
+     ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_string))
+     if(p->m_value->ptr_string()->capacity() > sso) ZJSON_STATS_ALLOC(p->m_value->ptr_string()->capacity()+1)
+     break;
+    }
+    case zJSON::JSON_ARRAY: { ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_array)) break; }
+    case zJSON::JSON_NODE: { ZJSON_STATS_ALLOC(sizeof(zJSON::zjson_node)) break; }
+   }
+   if(p->m_name.capacity() > sso) ZJSON_STATS_ALLOC(p->m_name.capacity()+1)
+  };
+#endif
+};
 
-void zJSON::zjson_bool::write(std::string& ret, const zJSON* const prn) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):"")+((value)?("true"):("false")); };
+template <class P> static zJSON* parse_json(const char* p, size_t len, size_t& pos, const zJSON::zOptionJSON& opt, zJSON::zErrorJSON* err)
+{
+ zjson_builder h;
+ if(!parse_engine<P>(h, p, len, pos, opt, err)) return NULL;
+ return h.release();
+};
 
-void zJSON::zjson_bool::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):std::string(level,' '))+((value)?("true"):("false")); };
+/*
+zjson_reuser builds the tree in place of the existing one. m_count keeps the number of the elements written to every open
+container: the element at that position is overwritten if it has the same type (the strings swap their buffers with the
+parser if the old one is too short), otherwise its value is replaced; the elements after the last written one are destroyed when the container ends.
+*/
+class zjson_reuser
+{
+ public:
+#ifdef ZJSON_STATS
+  enum { phase=zJSON::zStatsJSON::PHASE_PARSE };
+#endif
+  zjson_reuser(zJSON* p): m_root(p), m_current(NULL), m_count() { };
+
+  std::string* name_buffer() { return &m_name; };
+  std::string* string_buffer() { return &m_string; };
+  void value_null() { if(!reuse(zJSON::JSON_NULL)) place(new zJSON::zjson_null()); };
+  void value_boolean(bool value) { zJSON* p=reuse(zJSON::JSON_BOOLEAN); if(p) *p->m_value->ptr_boolean()=value; else place(new zJSON::zjson_bool(value)); };
+  void value_integer(int64_t value) { zJSON* p=reuse(zJSON::JSON_INTEGER); if(p) *p->m_value->ptr_integer()=value; else place(new zJSON::zjson_integer(value)); };
+  void value_number(double value) { zJSON* p=reuse(zJSON::JSON_NUMBER); if(p) *p->m_value->ptr_number()=value; else place(new zJSON::zjson_number(value)); };
+  void value_raw(const char* s, size_t n, int json_type)
+  {
+   zJSON* p=slot();
+   if(p != NULL && p->m_value->ptr_raw() != NULL) { use(p); static_cast<zJSON::zjson_raw_number*>(p->m_value)->assign(s, n, json_type); return; }
+   place(new zJSON::zjson_raw_number(s, n, json_type));
+  };
+  void value_string()
+  {
+   zJSON* p=reuse(zJSON::JSON_STRING);
+   if(p == NULL) p=place(new zJSON::zjson_string());
+   std::string* v=p->m_value->ptr_string();
+   if(v->capacity() >= m_string.size()) v->assign(m_string);
+   else v->swap(m_string);
+  };
+  void begin(int json_type)
+  {
+   zJSON* p=reuse(json_type);
+   if(p == NULL) p=place((json_type == zJSON::JSON_ARRAY)?((zJSON::zjson_base*) new zJSON::zjson_array()):((zJSON::zjson_base*) new zJSON::zjson_node()));
+   m_current=p;
+   m_count.push_back(0);
+  };
+  void end()
+  {
+   size_t n=m_count.back();
+   while(m_current->m_value->size() > n) m_current->m_value->pop_back();
+   m_count.pop_back();
+   m_current=m_current->m_parent;
+  };
+  void fail()
+  {
+   delete m_root->m_value;
+   m_root->m_value=new zJSON::zjson_null();
+  };
+
+ private:
+  zJSON* m_root;
+  zJSON* m_current;
+  std::vector<size_t> m_count;
+  std::string m_name;
+  std::string m_string;
+
+  zJSON* slot() { return (m_current == NULL)?(m_root):(m_current->m_value->at(m_count.back())); };
+  void use(zJSON* p)
+  {
+   if(m_current) ++m_count.back();
+   p->m_name.assign(m_name);
+  };
+  zJSON* reuse(int json_type)
+  {
+   zJSON* p=slot();
+   if(p == NULL || p->m_value->type() != json_type) return NULL;
+   use(p);
+   return p;
+  };
+  zJSON* place(zJSON::zjson_base* value)
+  {
+   zJSON* p=slot();
+   if(p == NULL)
+   {
+    p=new zJSON(m_name, value);
+    p->m_parent=m_current;
+    if(m_current->type() == zJSON::JSON_ARRAY) static_cast<zJSON::zjson_array*>(m_current->m_value)->value.push_back(p);
+    else static_cast<zJSON::zjson_node*>(m_current->m_value)->value.push_back(p);
+   }
+   else
+   {
+    delete p->m_value;
+    p->m_value=value;
+    p->m_name.assign(m_name);
+   }
+   if(m_current) ++m_count.back();
+#ifdef ZJSON_STATS
+   zjson_builder::allocated(p);
+#endif
+   return p;
+  };
+};
 
-void zJSON::zjson_integer::write(std::string& ret, const zJSON* const prn) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):"")+zJSON::toString(value); };
+template <class P> static bool parse_reuse(zJSON& ret, const char* p, size_t len, size_t& pos, const zJSON::zOptionJSON& opt, zJSON::zErrorJSON* err)
+{
+ zjson_reuser h(&ret);
+ if(parse_engine<P>(h, p, len, pos, opt, err)) return true;
+ h.fail();
+ return false;
+};
 
-void zJSON::zjson_integer::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):std::string(level,' '))+zJSON::toString(value); };
+zJSON::zjson_base* zJSON::zjson_raw_number::copy(zJSON* prn) const
+{
+ if(!changed()) return new zjson_raw_number(text.data(), text.size(), kind);
+ if(kind == zJSON::JSON_INTEGER) return new zJSON::zjson_integer(value.integer);
+ return new zJSON::zjson_number(value.number);
+};
 
-void zJSON::zjson_number::write(std::string& ret, const zJSON* const prn) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):"")+zJSON::toString(value); };
+bool zJSON::zjson_raw_number::as_string(std::string& ret) const
+{
+ if(!changed()) ret=text;
+ else if(kind == zJSON::JSON_INTEGER) ret=zJSON::toString(value.integer);
+ else ret=zJSON::toString(value.number);
+ return true;
+};
 
-void zJSON::zjson_number::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):std::string(level,' '))+zJSON::toString(value); };
+void zJSON::zjson_raw_number::convert() const
+{
+ if(__atomic_load_n(&ready, __ATOMIC_ACQUIRE) == 2) return;
+ int expected=0;
+ if(!__atomic_compare_exchange_n(&ready, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+ {
+  while(__atomic_load_n(&ready, __ATOMIC_ACQUIRE) != 2);
+  return;
+ }
+ size_t pos=0;
+ value.integer=0;
+ read_integer_number<zJSON::Strict>(text.data(), text.size(), pos, value.integer, value.number);
+ original=value;
+ if(kind == zJSON::JSON_INTEGER)
+ {
+  if(value.integer == INT64_MAX || value.integer == INT64_MIN) wide=strtod(text.c_str(), NULL);
+  else wide=(double) value.integer;
+ }
+ __atomic_store_n(&ready, 2, __ATOMIC_RELEASE);
+};
 
-void zJSON::zjson_string::write(std::string& ret, const zJSON* const prn) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):"")+('\"'+str_to_json(value.c_str(), value.size())+'\"'); };
+bool zJSON::zjson_raw_number::changed() const { return (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) == 2 && memcmp(&value, &original, sizeof(value)) != 0); };
 
-void zJSON::zjson_string::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{ ret+=((prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" : "):std::string(level,' '))+('\"'+str_to_json_formatted(value.c_str(), value.size())+'\"'); };
+double zJSON::zjson_raw_number::as_number() const
+{
+ convert();
+ if(kind != zJSON::JSON_INTEGER) return value.number;
+ return (changed())?((double) value.integer):(wide);
+};
 
 zJSON::zjson_array::zjson_array(const std::vector<zJSON*>& v, zJSON* prn)
 {
@@ -469,7 +1281,29 @@ zJSON* zJSON::zjson_array::search(const std::string& json_name, size_t start_pos
  return NULL;
 };
 
-void zJSON::zjson_array::clear() { for(size_t i=0; i < value.size(); i++) { value[i]->m_parent=NULL; delete value[i]; } value.clear(); };
+void zJSON::zjson_array::clear() { release(value); };
+
+void zJSON::zjson_array::release(std::vector<zJSON*>& v)
+{
+ std::vector<zJSON*> stack;
+ std::vector<zJSON*>* c;
+ zJSON* p;
+ stack.swap(v);
+ while(stack.size())
+ {
+  p=stack.back();
+  stack.pop_back();
+  p->m_parent=NULL;
+  c=NULL;
+  if(p->m_value)
+  {
+   if(p->m_value->type() == zJSON::JSON_ARRAY) c=&(static_cast<zjson_array*>(p->m_value)->value);
+   else if(p->m_value->type() == zJSON::JSON_NODE) c=&(static_cast<zjson_node*>(p->m_value)->value);
+  }
+  if(c) { stack.insert(stack.end(), c->begin(), c->end()); c->clear(); }
+  delete p;
+ }
+};
 
 zJSON* zJSON::zjson_array::insert(size_t pos, const zJSON& val, zJSON* prn)
 {
@@ -541,20 +1375,11 @@ zJSON* zJSON::zjson_array::remove(zJSON* p)
  return p;
 };
 
-void zJSON::zjson_array::write(std::string& ret, const zJSON* const prn) const
+void zJSON::zjson_array::detach(std::vector<zJSON*>& ret)
 {
- ret+=(prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\":["):"[";
- if(value.size()) value[0]->write(ret);
- for(size_t i=1; i < value.size(); i++) { ret+=','; value[i]->write(ret); }
- ret+=']';
-};
-
-void zJSON::zjson_array::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{
- ret+=(prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" :\n"+std::string(level,' ')+"[\n"):std::string(level,' ')+"[\n";
- if(value.size()) value[0]->m_value->write_formatted(ret, value[0], level+1);
- for(size_t i=1; i < value.size(); i++) { ret+=",\n"; value[i]->m_value->write_formatted(ret, value[i], level+1); }
- ret+='\n'+std::string(level,' ')+"]";
+ for(size_t i=0; i < value.size(); i++) value[i]->m_parent=NULL;
+ ret.swap(value);
+ value.clear();
 };
 
 zJSON::zjson_node::zjson_node(const std::vector<zJSON*>& v, zJSON* prn)
@@ -592,7 +1417,7 @@ zJSON* zJSON::zjson_node::search(const std::string& json_name, size_t start_pos)
  return NULL;
 };
 
-void zJSON::zjson_node::clear() { for(size_t i=0; i < value.size(); i++) { value[i]->m_parent=NULL; delete value[i]; } value.clear(); };
+void zJSON::zjson_node::clear() { zjson_array::release(value); };
 
 zJSON* zJSON::zjson_node::insert(size_t pos, const zJSON& val, zJSON* prn)
 {
@@ -664,23 +1489,13 @@ zJSON* zJSON::zjson_node::remove(zJSON* p)
  return p;
 };
 
-void zJSON::zjson_node::write(std::string& ret, const zJSON* const prn) const
+void zJSON::zjson_node::detach(std::vector<zJSON*>& ret)
 {
- ret+=(prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?('\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\":{"):"{";
- if(value.size()) value[0]->write(ret);
- for(size_t i=1; i < value.size(); i++) { ret+=','; value[i]->write(ret); }
- ret+='}';
+ for(size_t i=0; i < value.size(); i++) value[i]->m_parent=NULL;
+ ret.swap(value);
+ value.clear();
 };
 
-void zJSON::zjson_node::write_formatted(std::string& ret, const zJSON* const prn, size_t level) const
-{
- ret+=(prn->m_name.size() && ((prn->m_parent)?(prn->m_parent->type() != zJSON::JSON_ARRAY):true))?(std::string(level,' ')+'\"'+str_to_json(prn->m_name.c_str(), prn->m_name.size())+"\" :\n"+std::string(level,' ')+"{\n"):std::string(level,' ')+"{\n";
- if(value.size()) value[0]->m_value->write_formatted(ret, value[0], level+1);
- for(size_t i=1; i < value.size(); i++) { ret+=",\n"; value[i]->m_value->write_formatted(ret, value[i], level+1); }
- ret+='\n'+std::string(level,' ')+"}";
-};
-
-
 template <class T> static std::string toString(const T& t)
 {
  std::ostringstream ss;
@@ -699,10 +1514,11 @@ std::string zJSON::toString(int64_t value)
  std::string ret;
  ret.reserve(24);
  int sign=1;
- if(value < 0) { sign=-1; value*=(-1); }
- for(; value; value/=10)
+ uint64_t u=(uint64_t) value;
+ if(value < 0) { sign=-1; u=0-u; }
+ for(; u; u/=10)
  {
-  switch(value%10)
+  switch(u%10)
   {
    case 0:  { ret+='0'; break; }
    case 1:  { ret+='1'; break; }
@@ -820,92 +1636,566 @@ double zJSON::toDouble(const std::string &q, double def)
  return ret;
 };
 
-int64_t zJSON::toInteger(const std::string &q, int64_t def)
+int64_t zJSON::toInteger(const std::string &q, int64_t def)
+{
+ size_t s=q.find_first_not_of(" \n\r\t\v");
+ if(s == std::string::npos) return def;
+ int sign=1;
+ int64_t ret=0;
+ const char* p=&q[s];
+ size_t n=q.size()-s;
+ size_t i=0;
+ char c=*p;
+ switch(c)
+ {
+  case '-': { sign=-1; }
+  case '+': { ++p; ++i; c=*p; }
+ }
+ if(i == n || c < '0' || c > '9') return def;
+ for(; i < n; i++, ++p)
+ {
+  c=*p;
+  if(c < '0' || c > '9') break;
+  ret*=10; ret+=((unsigned char) c - '0');
+ }
+ ret*=sign;
+ return ret;
+};
+
+void zJSON::escape(std::string& ret, const char* src, size_t len) { json_escape(ret, src, len); };
+
+bool zJSON::valid_utf8(const char* src, size_t len) { return (check_utf8(src, len) == std::string::npos); };
+bool zJSON::valid_utf8(const char* src, size_t len, size_t& res_pos) { res_pos=check_utf8(src, len); return (res_pos == std::string::npos); };
+bool zJSON::valid_utf8(const std::string& src) { return (check_utf8(src.c_str(), src.size()) == std::string::npos); };
+bool zJSON::valid_utf8(const std::string& src, size_t& res_pos) { res_pos=check_utf8(src.c_str(), src.size()); return (res_pos == std::string::npos); };
+
+template <class P> zJSON* zJSON::parse(const char* src, size_t len, size_t pos)
+{
+ if(pos >= len) return NULL;
+ return parse_json<P>(src, len, pos, zJSON::zOptionJSON(), NULL);
+};
+
+template <class P> zJSON* zJSON::parse(const std::string& src, size_t pos)
+{
+ if(pos >= src.size()) return NULL;
+ return parse_json<P>(src.c_str(), src.size(), pos, zJSON::zOptionJSON(), NULL);
+};
+
+template <class P> zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos)
+{
+ res_pos=pos;
+ if(pos >= len) return NULL;
+ return parse_json<P>(src, len, res_pos, zJSON::zOptionJSON(), NULL);
+};
+
+template <class P> zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos)
+{
+ res_pos=pos;
+ if(pos >= src.size()) return NULL;
+ return parse_json<P>(src.c_str(), src.size(), res_pos, zJSON::zOptionJSON(), NULL);
+};
+
+template <class P> bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos)
+{
+ zJSON* p_json=zJSON::parse<P>(src, len, pos);
+ if(p_json == NULL) return false;
+ bool b=p_json->swap(ret);
+ delete p_json;
+ return b;
+};
+
+template <class P> bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos)
+{
+ zJSON* p_json=zJSON::parse<P>(src, pos);
+ if(p_json == NULL) return false;
+ bool b=p_json->swap(ret);
+ delete p_json;
+ return b;
+};
+
+template <class P> bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos)
+{
+ zJSON* p_json=zJSON::parse<P>(src, len, pos, res_pos);
+ if(p_json == NULL) return false;
+ bool b=p_json->swap(ret);
+ delete p_json;
+ return b;
+};
+
+template <class P> bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos)
+{
+ zJSON* p_json=zJSON::parse<P>(src, pos, res_pos);
+ if(p_json == NULL) return false;
+ bool b=p_json->swap(ret);
+ delete p_json;
+ return b;
+};
+
+enum { CURSOR_VALUE=0, CURSOR_FIRST, CURSOR_NAMED, CURSOR_AFTER, CURSOR_DONE };
+
+/*
+The cursor runs the loop of parse_engine step by step: m_state is the place of the loop where the next call continues, the
+frames are the same as the frames of the parser, so the errors are the same as parse reports.
+*/
+template <class P> zJSON::zCursorJSON<P>::zCursorJSON(const char* src, size_t len, size_t start_pos, const zJSON::zOptionJSON& opt):
+ m_src(src),
+ m_len(len),
+ m_full(len),
+ m_pos(start_pos),
+ m_opt(opt),
+ m_skip(false),
+ m_state(CURSOR_VALUE),
+ m_token(TOKEN_END),
+ m_last(JSON_CLASS_ERROR),
+ m_nodes(0),
+ m_depth(0),
+ m_more(),
+ m_text(src),
+ m_length(0),
+ m_buffer(),
+ m_boolean(false),
+ m_integer(0),
+ m_number(0.0),
+ m_error()
+{
+ if(start_pos < len && (len-start_pos) > opt.max_bytes) m_len=start_pos+opt.max_bytes;
+};
+
+template <class P> void zJSON::zCursorJSON<P>::push(char end)
+{
+ if(m_depth >= __local_frames__ && (m_depth-__local_frames__) >= m_more.size()) m_more.push_back(zjson_cursor_frame());
+ zjson_cursor_frame& f=frame(m_depth++);
+ f.end=end;
+ f.count=0;
+ f.name=std::string::npos;
+};
+
+template <class P> int zJSON::zCursorJSON<P>::close(size_t pos)
+{
+ char end=frame(--m_depth).end;
+ m_last=JSON_CLASS_ERROR;
+ m_state=CURSOR_AFTER;
+ m_pos=pos;
+ m_text=m_src+pos-1;
+ m_length=1;
+ return (m_token=(end == ']')?(TOKEN_END_ARRAY):(TOKEN_END_NODE));
+};
+
+template <class P> int zJSON::zCursorJSON<P>::fail(int code, size_t at, bool inside)
+{
+ set_error(&m_error, code, m_src, m_len, cut_error<P>(code, m_src, m_len, at));
+ if(m_error.code == zJSON::zErrorJSON::ERROR_EOF && m_len < m_full) m_error.code=zJSON::zErrorJSON::ERROR_BYTES_LIMIT;
+ std::string token;
+ size_t levels=(inside)?(m_depth):(m_depth-1);
+ for(size_t i=0; i < levels; ++i)
+ {
+  zjson_cursor_frame& f=frame(i);
+  path_token<P>(m_error.path, token, f.end, f.count, f.name, m_src, m_len);
+ }
+ m_text=m_src+m_pos;
+ m_length=0;
+ return (m_token=TOKEN_ERROR);
+};
+
+template <class P> void zJSON::zCursorJSON<P>::string_text(size_t start, size_t end, bool concatenated)
+{
+ const char* p=m_src+start+1;
+ size_t n=end-start-1;
+ if(!concatenated && memchr(p, '\\', n) == NULL) { m_text=p; m_length=n; return; }
+ m_buffer.clear();
+ if(!m_skip)
+ {
+  if(concatenated) read_string_value<P>(m_buffer, m_src, m_len, start);
+  else json_to_str(m_buffer, m_src, m_len, start+1, n);
+ }
+ m_text=m_buffer.data();
+ m_length=m_buffer.size();
+};
+
+template <class P> int zJSON::zCursorJSON<P>::next()
+{
+ const char* p=m_src;
+ size_t len=m_len;
+ size_t l=m_pos;
+ size_t at=0;
+ if(m_token == TOKEN_ERROR || m_state == CURSOR_DONE) return m_token;
+ for(;;)
+ {
+  if(m_state == CURSOR_AFTER)
+  {
+   if(m_depth == 0)
+   {
+    if(m_last == JSON_CLASS_NUMBER && l == len && len < m_full) return fail(zJSON::zErrorJSON::ERROR_EOF, l, true);
+    m_state=CURSOR_DONE;
+    m_pos=l;
+    m_text=p+l;
+    m_length=0;
+    return (m_token=TOKEN_END);
+   }
+   zjson_cursor_frame& f=frame(m_depth-1);
+   if(!parse_separator<P>(p, len, l, f.end))
+   {
+    return fail((l < len && p[l] == f.end)?(zJSON::zErrorJSON::ERROR_TOKEN):(zJSON::zErrorJSON::ERROR_SEPARATOR), l, false);
+   }
+   if(l < len && p[l] == f.end) return close(l+1);
+   ++f.count;
+   f.name=std::string::npos;
+   m_state=CURSOR_VALUE;
+  }
+  PARSE_BLANK(p, len, l)
+  if(m_state == CURSOR_FIRST)
+  {
+   if(l < len && p[l] == frame(m_depth-1).end) return close(l+1);
+   m_state=CURSOR_VALUE;
+  }
+  if(m_state == CURSOR_VALUE && (m_depth || P::relaxed))
+  {
+   zjson_cursor_frame* f=(m_depth)?(&frame(m_depth-1)):(NULL);
+   if(f && f->count >= m_opt.max_elements) return fail(zJSON::zErrorJSON::ERROR_ELEMENTS_LIMIT, l, false);
+   if(P::relaxed || f->end == '}')
+   {
+    size_t n=l, end=0;
+    int res=read_name<P>(NULL, p, len, n, at, m_opt, &end);
+    if(res == zJSON::zErrorJSON::ERROR_NONE)
+    {
+     if(f) f->name=l;
+     string_text(l, end, false);
+     m_state=CURSOR_NAMED;
+     m_pos=n;
+     return (m_token=TOKEN_NAME);
+    }
+    if(!P::relaxed) return fail(res, at, true);
+   }
+  }
+  break;
+ }
+ m_state=CURSOR_VALUE;
+ if(l >= len) return fail(zJSON::zErrorJSON::ERROR_EOF, l, true);
+ if(++m_nodes > m_opt.max_nodes) return fail(zJSON::zErrorJSON::ERROR_NODES_LIMIT, l, true);
+ size_t start=l;
+ m_last=__json_class__[(unsigned char) p[l]];
+ switch(m_last)
+ {
+  case JSON_CLASS_LITERAL:
+  {
+   switch(read_null_bool(p, len, l, m_boolean))
+   {
+    case zJSON::JSON_NULL: { m_token=TOKEN_NULL; break; }
+    case zJSON::JSON_BOOLEAN: { m_token=TOKEN_BOOLEAN; break; }
+    default: { return fail(zJSON::zErrorJSON::ERROR_TOKEN, l, true); }
+   }
+   m_text=p+start;
+   m_length=l-start;
+   break;
+  }
+  case JSON_CLASS_STRING:
+  {
+   size_t end=0;
+   int res=read_value_string<P>(NULL, p, len, l, at, m_opt, &end);
+   if(res != zJSON::zErrorJSON::ERROR_NONE) return fail(res, at, true);
+   string_text(start, end, (end+1 != l));
+   m_token=TOKEN_STRING;
+   break;
+  }
+  case JSON_CLASS_NUMBER:
+  {
+   switch(read_integer_number<P>(p, len, l, m_integer, m_number))
+   {
+    case zJSON::JSON_INTEGER: { m_token=TOKEN_INTEGER; break; }
+    case zJSON::JSON_NUMBER: { m_token=TOKEN_NUMBER; break; }
+    default: { return fail(zJSON::zErrorJSON::ERROR_NUMBER, l, true); }
+   }
+   m_text=p+start;
+   m_length=l-start;
+   break;
+  }
+  case JSON_CLASS_ARRAY:
+  case JSON_CLASS_NODE:
+  {
+   if(m_depth >= m_opt.max_depth) return fail(zJSON::zErrorJSON::ERROR_DEPTH, l, true);
+   push((m_last == JSON_CLASS_ARRAY)?(']'):('}'));
+   m_state=CURSOR_FIRST;
+   m_pos=l+1;
+   m_text=p+start;
+   m_length=1;
+   return (m_token=(m_last == JSON_CLASS_ARRAY)?(TOKEN_BEGIN_ARRAY):(TOKEN_BEGIN_NODE));
+  }
+  default: { return fail(zJSON::zErrorJSON::ERROR_TOKEN, l, true); }
+ }
+ m_state=CURSOR_AFTER;
+ m_pos=l;
+ return m_token;
+};
+
+template <class P> bool zJSON::zCursorJSON<P>::skip()
+{
+ size_t depth=m_depth;
+ switch(m_token)
+ {
+  case TOKEN_ERROR: { return false; }
+  case TOKEN_NAME: { break; }
+  case TOKEN_BEGIN_ARRAY:
+  case TOKEN_BEGIN_NODE: { --depth; break; }
+  default: { return true; }
+ }
+ m_skip=true;
+ int t=(m_token == TOKEN_NAME)?(next()):(m_token);
+ while(t != TOKEN_ERROR && m_depth > depth) t=next();
+ m_skip=false;
+ return (t != TOKEN_ERROR);
+};
+
+template class zJSON::zCursorJSON<zJSON::Strict>;
+template class zJSON::zCursorJSON<zJSON::Extended>;
+
+template <class P> bool zJSON::parse_into(zJSON& ret, const char* src, size_t len, size_t pos)
+{
+ if(pos >= len) { zjson_reuser(&ret).fail(); return false; }
+ return parse_reuse<P>(ret, src, len, pos, zJSON::zOptionJSON(), NULL);
+};
+
+template <class P> bool zJSON::parse_into(zJSON& ret, const std::string& src, size_t pos)
+{ return zJSON::parse_into<P>(ret, src.c_str(), src.size(), pos); };
+
+template <class P> bool zJSON::parse_into(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{
+ err.clear();
+ res_pos=pos;
+ if(pos >= len) { set_error(&err, zJSON::zErrorJSON::ERROR_EOF, src, len, pos); zjson_reuser(&ret).fail(); return false; }
+ return parse_reuse<P>(ret, src, len, res_pos, opt, &err);
+};
+
+template <class P> bool zJSON::parse_into(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{ return zJSON::parse_into<P>(ret, src.c_str(), src.size(), pos, res_pos, err, opt); };
+
+template <class P> zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt)
+{
+ res_pos=pos;
+ if(pos >= len) return NULL;
+ return parse_json<P>(src, len, res_pos, opt, NULL);
+};
+
+template <class P> zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt)
+{ return zJSON::parse<P>(src.c_str(), src.size(), pos, res_pos, opt); };
+
+template <class P> zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{
+ err.clear();
+ res_pos=pos;
+ if(pos >= len) { set_error(&err, zJSON::zErrorJSON::ERROR_EOF, src, len, pos); return NULL; }
+ return parse_json<P>(src, len, res_pos, opt, &err);
+};
+
+template <class P> zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{ return zJSON::parse<P>(src.c_str(), src.size(), pos, res_pos, err, opt); };
+
+#define ZJSON_PARSE_INSTANCE(P)\
+template zJSON* zJSON::parse<P>(const char* src, size_t len, size_t pos);\
+template zJSON* zJSON::parse<P>(const std::string& src, size_t pos);\
+template zJSON* zJSON::parse<P>(const char* src, size_t len, size_t pos, size_t& res_pos);\
+template zJSON* zJSON::parse<P>(const std::string& src, size_t pos, size_t& res_pos);\
+template bool zJSON::parse<P>(zJSON& ret, const char* src, size_t len, size_t pos);\
+template bool zJSON::parse<P>(zJSON& ret, const std::string& src, size_t pos);\
+template bool zJSON::parse<P>(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos);\
+template bool zJSON::parse<P>(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos);\
+template zJSON* zJSON::parse<P>(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt);\
+template zJSON* zJSON::parse<P>(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt);\
+template zJSON* zJSON::parse<P>(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+template zJSON* zJSON::parse<P>(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+template bool zJSON::parse_into<P>(zJSON& ret, const char* src, size_t len, size_t pos);\
+template bool zJSON::parse_into<P>(zJSON& ret, const std::string& src, size_t pos);\
+template bool zJSON::parse_into<P>(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+template bool zJSON::parse_into<P>(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+
+ZJSON_PARSE_INSTANCE(zJSON::Strict)
+ZJSON_PARSE_INSTANCE(zJSON::Extended)
+
+zJSON* zJSON::parse(const char* src, size_t len, size_t pos) { return zJSON::parse<zJSON::Extended>(src, len, pos); };
+zJSON* zJSON::parse(const std::string& src, size_t pos) { return zJSON::parse<zJSON::Extended>(src, pos); };
+zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos) { return zJSON::parse<zJSON::Extended>(src, len, pos, res_pos); };
+zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos) { return zJSON::parse<zJSON::Extended>(src, pos, res_pos); };
+bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos) { return zJSON::parse<zJSON::Extended>(ret, src, len, pos); };
+bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos) { return zJSON::parse<zJSON::Extended>(ret, src, pos); };
+bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos) { return zJSON::parse<zJSON::Extended>(ret, src, len, pos, res_pos); };
+bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos) { return zJSON::parse<zJSON::Extended>(ret, src, pos, res_pos); };
+zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt) { return zJSON::parse<zJSON::Extended>(src, len, pos, res_pos, opt); };
+zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt) { return zJSON::parse<zJSON::Extended>(src, pos, res_pos, opt); };
+zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::parse<zJSON::Extended>(src, len, pos, res_pos, err, opt); };
+zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::parse<zJSON::Extended>(src, pos, res_pos, err, opt); };
+bool zJSON::parse_into(zJSON& ret, const char* src, size_t len, size_t pos) { return zJSON::parse_into<zJSON::Extended>(ret, src, len, pos); };
+bool zJSON::parse_into(zJSON& ret, const std::string& src, size_t pos) { return zJSON::parse_into<zJSON::Extended>(ret, src, pos); };
+bool zJSON::parse_into(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::parse_into<zJSON::Extended>(ret, src, len, pos, res_pos, err, opt); };
+bool zJSON::parse_into(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::parse_into<zJSON::Extended>(ret, src, pos, res_pos, err, opt); };
+
+template <class P> bool zJSON::validate(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt)
+{
+ res_pos=pos;
+ if(pos >= len) return false;
+ size_t l=pos;
+ zjson_null_handler h;
+ if(!parse_engine<P>(h, src, len, l, opt, NULL)) return false;
+ res_pos=l;
+ return true;
+};
+
+template <class P> bool zJSON::validate(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{
+ err.clear();
+ res_pos=pos;
+ if(pos >= len) return set_error(&err, zJSON::zErrorJSON::ERROR_EOF, src, len, pos);
+ size_t l=pos;
+ zjson_null_handler h;
+ if(!parse_engine<P>(h, src, len, l, opt, &err)) return false;
+ res_pos=l;
+ return true;
+};
+
+template <class P> bool zJSON::validate(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt)
+{ return zJSON::validate<P>(src.c_str(), src.size(), pos, res_pos, err, opt); };
+
+template <class P> bool zJSON::validate(const char* src, size_t len, size_t pos, const zJSON::zOptionJSON& opt)
+{ size_t res_pos; return zJSON::validate<P>(src, len, pos, res_pos, opt); };
+
+template <class P> bool zJSON::validate(const std::string& src, size_t pos, const zJSON::zOptionJSON& opt)
+{ size_t res_pos; return zJSON::validate<P>(src.c_str(), src.size(), pos, res_pos, opt); };
+
+template <class P> bool zJSON::validate(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt)
+{ return zJSON::validate<P>(src.c_str(), src.size(), pos, res_pos, opt); };
+
+#define ZJSON_VALIDATE_INSTANCE(P)\
+template bool zJSON::validate<P>(const char* src, size_t len, size_t pos, const zJSON::zOptionJSON& opt);\
+template bool zJSON::validate<P>(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt);\
+template bool zJSON::validate<P>(const std::string& src, size_t pos, const zJSON::zOptionJSON& opt);\
+template bool zJSON::validate<P>(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt);\
+template bool zJSON::validate<P>(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+template bool zJSON::validate<P>(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt);\
+
+ZJSON_VALIDATE_INSTANCE(zJSON::Strict)
+ZJSON_VALIDATE_INSTANCE(zJSON::Extended)
+
+bool zJSON::validate(const char* src, size_t len, size_t pos, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, len, pos, opt); };
+bool zJSON::validate(const char* src, size_t len, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, len, pos, res_pos, opt); };
+bool zJSON::validate(const std::string& src, size_t pos, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, pos, opt); };
+bool zJSON::validate(const std::string& src, size_t pos, size_t& res_pos, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, pos, res_pos, opt); };
+bool zJSON::validate(const char* src, size_t len, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, len, pos, res_pos, err, opt); };
+bool zJSON::validate(const std::string& src, size_t pos, size_t& res_pos, zJSON::zErrorJSON& err, const zJSON::zOptionJSON& opt) { return zJSON::validate<zJSON::Extended>(src, pos, res_pos, err, opt); };
+
+const char* zJSON::zErrorJSON::reason() const
 {
- size_t s=q.find_first_not_of(" \n\r\t\v");
- if(s == std::string::npos) return def;
- int sign=1;
- int64_t ret=0;
- const char* p=&q[s];
- size_t n=q.size()-s;
- size_t i=0;
- char c=*p;
- switch(c)
- {
-  case '-': { sign=-1; }
-  case '+': { ++p; ++i; c=*p; }
- }
- if(i == n || c < '0' || c > '9') return def;
- for(; i < n; i++, ++p)
+ switch(code)
  {
-  c=*p;
-  if(c < '0' || c > '9') break;
-  ret*=10; ret+=((unsigned char) c - '0');
+  case ERROR_NONE: { return "no error"; }
+  case ERROR_EOF: { return "unexpected end of text"; }
+  case ERROR_TOKEN: { return "unexpected character"; }
+  case ERROR_NAME: { return "invalid object name"; }
+  case ERROR_STRING: { return "invalid string"; }
+  case ERROR_NUMBER: { return "invalid number"; }
+  case ERROR_SEPARATOR: { return "expected ',' or end of array or object"; }
+  case ERROR_DEPTH: { return "nesting is too deep"; }
+  case ERROR_STRING_LIMIT: { return "string is too long"; }
+  case ERROR_ELEMENTS_LIMIT: { return "too many elements"; }
+  case ERROR_NODES_LIMIT: { return "too many values"; }
+  case ERROR_BYTES_LIMIT: { return "text is too long"; }
+  case ERROR_UTF8: { return "invalid UTF-8 sequence"; }
+  case ERROR_READ: { return "source read error"; }
  }
- ret*=sign;
+ return "unknown error";
+};
+
+std::string zJSON::zErrorJSON::message() const
+{
+ std::string ret(reason());
+ if(code == ERROR_NONE) return ret;
+ ret+=" at line "+zJSON::toString((uint64_t) line)+", column "+zJSON::toString((uint64_t) column)+" (offset "+zJSON::toString((uint64_t) offset)+")";
+ if(path.size()) ret+=" in "+path;
  return ret;
 };
 
-zJSON* zJSON::parse(const char* src, size_t len, size_t pos)
+#ifdef ZJSON_STATS
+void zJSON::zStatsJSON::clear()
 {
- if(pos >= len) return NULL;
- return parse_json(src, len, pos);
+ for(size_t i=0; i <= zJSON::JSON_NODE; i++) nodes[i]=0;
+ bytes=0;
+ allocations=0;
+ allocated=0;
+ max_depth=0;
+ for(size_t i=0; i < PHASES; i++) { calls[i]=0; time[i]=0; }
 };
 
-zJSON* zJSON::parse(const std::string& src, size_t pos)
+void zJSON::zStatsJSON::add(const zJSON::zStatsJSON& src)
 {
- if(pos >= src.size()) return NULL;
- return parse_json(src.c_str(), src.size(), pos);
+ for(size_t i=0; i <= zJSON::JSON_NODE; i++) nodes[i]+=src.nodes[i];
+ bytes+=src.bytes;
+ allocations+=src.allocations;
+ allocated+=src.allocated;
+ if(src.max_depth > max_depth) max_depth=src.max_depth;
+ for(size_t i=0; i < PHASES; i++) { calls[i]+=src.calls[i]; time[i]+=src.time[i]; }
 };
 
-zJSON* zJSON::parse(const char* src, size_t len, size_t pos, size_t& res_pos)
+const zJSON::zStatsJSON& zJSON::last_stats() { return __stats_call__; };
+const zJSON::zStatsJSON& zJSON::thread_stats() { return __stats_thread__; };
+void zJSON::reset_stats() { __stats_call__.clear(); __stats_thread__.clear(); };
+void zJSON::stats_hook(zJSON::zStatsHookJSON hook, void* arg) { __stats_hook__=hook; __stats_arg__=arg; };
+#endif
+
+bool zJSON::scan_blank(const char* src, size_t len, size_t& pos)
 {
- res_pos=pos;
- if(pos >= len) return NULL;
- return parse_json(src, len, res_pos);
+ parse_blank<zJSON::Extended>(src, len, pos);
+ return (pos < len);
 };
 
-zJSON* zJSON::parse(const std::string& src, size_t pos, size_t& res_pos)
+bool zJSON::scan_name(std::string& ret, const char* src, size_t len, size_t& pos)
 {
- res_pos=pos;
- if(pos >= src.size()) return NULL;
- return parse_json(src.c_str(), src.size(), res_pos);
+ size_t l=pos;
+ parse_blank<zJSON::Extended>(src, len, l);
+ std::string s;
+ if(!parse_name<zJSON::Extended>(s, src, len, l)) return false;
+ ret.swap(s);
+ pos=l;
+ return true;
 };
 
-bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos)
+bool zJSON::scan_string(std::string& ret, const char* src, size_t len, size_t& pos)
 {
- zJSON* p_json=zJSON::parse(src, len, pos);
- if(p_json == NULL) return false;
- bool b=p_json->swap(ret);
- delete p_json;
- return b;
+ size_t l=pos;
+ parse_blank<zJSON::Extended>(src, len, l);
+ std::string s;
+ if(!read_string_value<zJSON::Extended>(s, src, len, l)) return false;
+ ret.swap(s);
+ pos=l;
+ return true;
 };
 
-bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos)
+int zJSON::scan_number(int64_t& integer, double& number, const char* src, size_t len, size_t& pos)
 {
- zJSON* p_json=zJSON::parse(src, pos);
- if(p_json == NULL) return false;
- bool b=p_json->swap(ret);
- delete p_json;
- return b;
+ size_t l=pos;
+ parse_blank<zJSON::Extended>(src, len, l);
+ int ret=read_integer_number<zJSON::Extended>(src, len, l, integer, number);
+ if(ret < 0) return ret;
+ if(ret == zJSON::JSON_INTEGER) number=(double) integer;
+ else if(number < -9223372036854775808.0) integer=INT64_MIN;
+ else if(number >= 9223372036854775808.0) integer=INT64_MAX;
+ else integer=(int64_t) number;
+ pos=l;
+ return ret;
 };
 
-bool zJSON::parse(zJSON& ret, const char* src, size_t len, size_t pos, size_t& res_pos)
+int zJSON::scan_literal(bool& value, const char* src, size_t len, size_t& pos)
 {
- zJSON* p_json=zJSON::parse(src, len, pos, res_pos);
- if(p_json == NULL) return false;
- bool b=p_json->swap(ret);
- delete p_json;
- return b;
+ size_t l=pos;
+ parse_blank<zJSON::Extended>(src, len, l);
+ int ret=read_null_bool(src, len, l, value);
+ if(ret >= 0) pos=l;
+ return ret;
 };
 
-bool zJSON::parse(zJSON& ret, const std::string& src, size_t pos, size_t& res_pos)
+bool zJSON::skip(const char* src, size_t len, size_t& pos)
 {
- zJSON* p_json=zJSON::parse(src, pos, res_pos);
- if(p_json == NULL) return false;
- bool b=p_json->swap(ret);
- delete p_json;
- return b;
+ size_t l=pos;
+ zjson_null_handler h;
+ if(!parse_engine<zJSON::Extended>(h, src, len, l, zJSON::zOptionJSON(), NULL)) return false;
+ pos=l;
+ return true;
 };
 
 zJSON::zJSON(int json_type, const std::string& json_name):
@@ -1009,9 +2299,10 @@ zJSON::zJSON(const std::string& json_name, int64_t json_value):
 zJSON::zJSON(const std::string& json_name, uint64_t json_value):
  m_parent(NULL),
  m_name(json_name),
- m_value(new zJSON::zjson_integer((int64_t) json_value)),
+ m_value(NULL),
  param(NULL)
 {
+ operator=(json_value);
 };
 
 zJSON::zJSON(const std::string& json_name, float json_value):
@@ -1136,7 +2427,9 @@ zJSON& zJSON::operator=(int64_t json_value)
 zJSON& zJSON::operator=(uint64_t json_value)
 {
  if(m_value) { delete m_value; m_value=NULL; }
- m_value=new zJSON::zjson_integer((int64_t) json_value);
+ if(json_value <= (uint64_t) INT64_MAX) { m_value=new zJSON::zjson_integer((int64_t) json_value); return *this; }
+ std::string s=zJSON::toString(json_value);
+ m_value=new zJSON::zjson_raw_number(s.data(), s.size(), zJSON::JSON_INTEGER);
  return *this;
 };
 
@@ -1192,6 +2485,34 @@ bool zJSON::swap(zJSON& src)
  return true;
 };
 
+/*
+zjson_exact_integer returns the sign and the magnitude of JSON_INTEGER without the limits of int64_t (the source text is read
+if it is kept). Returns false if the magnitude does not fit uint64_t. The function is shared with the binary writers.
+*/
+bool zjson_exact_integer(const zJSON& src, bool& negative, uint64_t& magnitude)
+{
+ const std::string* raw=src.ptr_raw();
+ if(raw == NULL)
+ {
+  int64_t n=*src.ptr_integer();
+  negative=(n < 0);
+  magnitude=(negative)?(0-(uint64_t) n):((uint64_t) n);
+  return true;
+ }
+ const char* p=raw->c_str();
+ negative=(*p == '-');
+ if(negative) ++p;
+ magnitude=0;
+ for(; *p; ++p)
+ {
+  unsigned d=((unsigned char) *p - '0');
+  if(magnitude > (UINT64_MAX-d)/10) return false;
+  magnitude=magnitude*10+d;
+ }
+ if(magnitude == 0) negative=false;
+ return true;
+};
+
 bool zJSON::operator==(const zJSON& src) const
 {
  if(&src == this) return true;
@@ -1199,7 +2520,15 @@ bool zJSON::operator==(const zJSON& src) const
  {
   case zJSON::JSON_NULL: { return (src.type() == zJSON::JSON_NULL); }
   case zJSON::JSON_BOOLEAN: { return (src == *m_value->ptr_boolean()); }
-  case zJSON::JSON_INTEGER: { return (src == *m_value->ptr_integer()); }
+  case zJSON::JSON_INTEGER:
+  {
+   if(src.type() != zJSON::JSON_INTEGER) return (src == *m_value->ptr_integer());
+   bool a_negative, b_negative;
+   uint64_t a, b;
+   bool a_exact=zjson_exact_integer(*this, a_negative, a), b_exact=zjson_exact_integer(src, b_negative, b);
+   if(a_exact && b_exact) return (a_negative == b_negative && a == b);
+   return (!a_exact && !b_exact && *ptr_raw() == *src.ptr_raw());
+  }
   case zJSON::JSON_NUMBER: { return (src == *m_value->ptr_number()); }
   case zJSON::JSON_STRING: { return (src == *m_value->ptr_string()); }
  }
@@ -1233,13 +2562,33 @@ bool zJSON::operator==(int64_t json_value) const
 {
  switch(m_value->type())
  {
-  case zJSON::JSON_INTEGER: { return (*m_value->ptr_integer() == json_value); }
+  case zJSON::JSON_INTEGER:
+  {
+   if(m_value->ptr_raw() == NULL) return (*m_value->ptr_integer() == json_value);
+   bool negative;
+   uint64_t magnitude;
+   if(!zjson_exact_integer(*this, negative, magnitude)) return false;
+   return (negative == (json_value < 0) && magnitude == ((json_value < 0)?(0-(uint64_t) json_value):((uint64_t) json_value)));
+  }
   case zJSON::JSON_NUMBER: { return (*m_value->ptr_number() == (double) json_value); }
  }
  return false;
 };
 
-bool zJSON::operator==(uint64_t json_value) const { return operator==((int64_t) json_value); };
+bool zJSON::operator==(uint64_t json_value) const
+{
+ switch(m_value->type())
+ {
+  case zJSON::JSON_INTEGER:
+  {
+   bool negative;
+   uint64_t magnitude;
+   return (zjson_exact_integer(*this, negative, magnitude) && !negative && magnitude == json_value);
+  }
+  case zJSON::JSON_NUMBER: { return (*m_value->ptr_number() == (double) json_value); }
+ }
+ return false;
+};
 
 bool zJSON::operator==(float json_value) const { return operator==((double) json_value); };
 
@@ -1267,6 +2616,423 @@ bool zJSON::operator==(const std::string & json_value) const
  return (*m_value->ptr_string() == json_value);
 };
 
+static bool json_equal(const zJSON& a, const zJSON& b)
+{
+ int ta=a.type();
+ int tb=b.type();
+ if(ta == zJSON::JSON_INTEGER) ta=zJSON::JSON_NUMBER;
+ if(tb == zJSON::JSON_INTEGER) tb=zJSON::JSON_NUMBER;
+ if(ta != tb) return false;
+ switch(ta)
+ {
+  case zJSON::JSON_NULL: { return true; }
+  case zJSON::JSON_ARRAY:
+  {
+   if(a.size() != b.size()) return false;
+   for(size_t i=0; i < a.size(); i++) { if(!json_equal(*a.at(i), *b.at(i))) return false; }
+   return true;
+  }
+  case zJSON::JSON_NODE:
+  {
+   if(a.size() != b.size()) return false;
+   size_t j, k;
+   for(size_t i=0; i < a.size(); i++)
+   {
+    const std::string& json_name=a.at(i)->name();
+    j=a.find(json_name);
+    k=b.find(json_name);
+    while(j < i && k != std::string::npos) { j=a.find(json_name, j+1); k=b.find(json_name, k+1); }
+    if(k == std::string::npos || !json_equal(*a.at(i), *b.at(k))) return false;
+   }
+   return true;
+  }
+ }
+ return (a == b);
+};
+
+static bool pointer_token(std::string& ret, const std::string& path, size_t& pos)
+{
+ ret.clear();
+ for(++pos; pos < path.size() && path[pos] != '/'; ++pos)
+ {
+  if(path[pos] != '~') { ret+=path[pos]; continue; }
+  if((pos+1) == path.size()) return false;
+  ++pos;
+  switch(path[pos])
+  {
+   case '0': { ret+='~'; break; }
+   case '1': { ret+='/'; break; }
+   default: { return false; }
+  }
+ }
+ return true;
+};
+
+static bool pointer_index(size_t& ret, const std::string& token)
+{
+ if(token.empty() || token.size() > 18 || (token[0] == '0' && token.size() > 1)) return false;
+ ret=0;
+ for(size_t i=0; i < token.size(); i++)
+ {
+  if(token[i] < '0' || token[i] > '9') return false;
+  ret*=10; ret+=((unsigned char) token[i] - '0');
+ }
+ return true;
+};
+
+static zJSON* pointer_parent(const zJSON* p, const std::string& path, std::string& token)
+{
+ size_t n=path.rfind('/');
+ if(n == std::string::npos) return NULL;
+ zJSON* ret=p->pointer(path.substr(0, n));
+ if(ret == NULL || !pointer_token(token, path, n)) return NULL;
+ return ret;
+};
+
+static void swap_value(zJSON& a, zJSON& b)
+{
+ a.swap(b);
+ a.name().swap(b.name());
+ zJSON::zParamJSON* pp=a.param;
+ a.param=b.param;
+ b.param=pp;
+};
+
+class zjson_patch
+{
+ public:
+  zjson_patch(zJSON* p): root(p), log() { };
+  ~zjson_patch() { };
+
+  bool apply(const zJSON& op);
+  void commit();
+  void rollback();
+
+ protected:
+  enum { UNDO_ATTACHED=0, UNDO_DETACHED, UNDO_ROOT };
+
+  struct zjson_undo
+  {
+   int action;
+   bool own;
+   zJSON* prn;
+   size_t pos;
+   zJSON* p;
+   std::string name;
+  };
+
+  zJSON* root;
+  std::vector<zjson_undo> log;
+
+  void record(int action, bool own, zJSON* prn, size_t pos, zJSON* p, const std::string& json_name);
+  void detach(zJSON* p, bool own);
+  bool attach(zJSON* prn, size_t pos, zJSON* p, const std::string& json_name, bool own);
+  bool replace_root(zJSON* p, bool own);
+  bool add(const std::string& path, zJSON* p, bool own);
+};
+
+void zjson_patch::record(int action, bool own, zJSON* prn, size_t pos, zJSON* p, const std::string& json_name)
+{
+ log.push_back(zjson_undo());
+ zjson_undo& u=log.back();
+ u.action=action;
+ u.own=own;
+ u.prn=prn;
+ u.pos=pos;
+ u.p=p;
+ u.name=json_name;
+};
+
+void zjson_patch::detach(zJSON* p, bool own)
+{
+ zJSON* prn=p->parent();
+ size_t pos=p->index();
+ p->remove();
+ record(UNDO_DETACHED, own, prn, pos, p, p->name());
+};
+
+bool zjson_patch::attach(zJSON* prn, size_t pos, zJSON* p, const std::string& json_name, bool own)
+{
+ std::string s(json_name);
+ s.swap(p->name());
+ if(prn->insert(pos, p) == NULL) { s.swap(p->name()); if(own) delete p; return false; }
+ record(UNDO_ATTACHED, own, prn, pos, p, s);
+ return true;
+};
+
+bool zjson_patch::replace_root(zJSON* p, bool own)
+{
+ swap_value(*root, *p);
+ record(UNDO_ROOT, own, NULL, 0, p, "");
+ return true;
+};
+
+bool zjson_patch::add(const std::string& path, zJSON* p, bool own)
+{
+ if(path.empty()) return replace_root(p, own);
+ std::string token;
+ size_t pos=std::string::npos;
+ zJSON* prn=pointer_parent(root, path, token);
+ if(prn != NULL && prn->type() == zJSON::JSON_NODE)
+ {
+  pos=prn->find(token);
+  if(pos != std::string::npos) detach(prn->at(pos), true);
+  else pos=prn->size();
+  return attach(prn, pos, p, token, own);
+ }
+ if(prn != NULL && prn->type() == zJSON::JSON_ARRAY)
+ {
+  if(token == "-") pos=prn->size();
+  else if(!pointer_index(pos, token) || pos > prn->size()) pos=std::string::npos;
+  if(pos != std::string::npos) return attach(prn, pos, p, "", own);
+ }
+ if(own) delete p;
+ return false;
+};
+
+bool zjson_patch::apply(const zJSON& op)
+{
+ const zJSON* p_op=op.search("op");
+ const zJSON* p_path=op.search("path");
+ const zJSON* p_from=op.search("from");
+ const zJSON* p_value=op.search("value");
+ if(p_op == NULL || p_op->type() != zJSON::JSON_STRING) return false;
+ if(p_path == NULL || p_path->type() != zJSON::JSON_STRING) return false;
+ if(p_from != NULL && p_from->type() != zJSON::JSON_STRING) return false;
+ const std::string& json_op=*p_op->ptr_string();
+ const std::string& path=*p_path->ptr_string();
+ zJSON* p;
+ if(json_op == "add")
+ {
+  if(p_value == NULL) return false;
+  return add(path, new zJSON(*p_value), true);
+ }
+ if(json_op == "remove")
+ {
+  p=root->pointer(path);
+  if(p == NULL || p == root) return false;
+  detach(p, true);
+  return true;
+ }
+ if(json_op == "replace")
+ {
+  p=root->pointer(path);
+  if(p == NULL || p_value == NULL) return false;
+  if(p == root) return replace_root(new zJSON(*p_value), true);
+  zJSON* prn=p->parent();
+  size_t pos=p->index();
+  detach(p, true);
+  return attach(prn, pos, new zJSON(*p_value), p->name(), true);
+ }
+ if(json_op == "move")
+ {
+  if(p_from == NULL) return false;
+  const std::string& from=*p_from->ptr_string();
+  if(from == path) return (root->pointer(path) != NULL);
+  if(path.size() > from.size() && path[from.size()] == '/' && path.compare(0, from.size(), from) == 0) return false;
+  p=root->pointer(from);
+  if(p == NULL || p == root) return false;
+  detach(p, false);
+  return add(path, p, false);
+ }
+ if(json_op == "copy")
+ {
+  if(p_from == NULL) return false;
+  p=root->pointer(*p_from->ptr_string());
+  if(p == NULL) return false;
+  return add(path, new zJSON(*p), true);
+ }
+ if(json_op == "test")
+ {
+  p=root->pointer(path);
+  return (p != NULL && p_value != NULL && json_equal(*p, *p_value));
+ }
+ return false;
+};
+
+void zjson_patch::commit()
+{
+ for(size_t i=0; i < log.size(); i++)
+ {
+  zjson_undo& u=log[i];
+  if(u.action == UNDO_ROOT || (u.action == UNDO_DETACHED && u.own)) delete u.p;
+ }
+ log.clear();
+};
+
+void zjson_patch::rollback()
+{
+ for(size_t i=log.size(); i > 0; i--)
+ {
+  zjson_undo& u=log[i-1];
+  switch(u.action)
+  {
+   case UNDO_ATTACHED:
+   {
+    if(u.own) { delete u.p; break; }
+    u.p->remove();
+    u.p->name().swap(u.name);
+    break;
+   }
+   case UNDO_DETACHED:
+   {
+    u.p->name().swap(u.name);
+    u.prn->insert(u.pos, u.p);
+    break;
+   }
+   case UNDO_ROOT:
+   {
+    swap_value(*root, *u.p);
+    if(u.own) delete u.p;
+    break;
+   }
+  }
+ }
+ log.clear();
+};
+
+zJSON* zJSON::pointer(const std::string& path) const
+{
+ zJSON* ret=const_cast<zJSON*>(this);
+ std::string token;
+ size_t n;
+ for(size_t pos=0; pos < path.size();)
+ {
+  if(path[pos] != '/' || !pointer_token(token, path, pos)) return NULL;
+  switch(ret->type())
+  {
+   case zJSON::JSON_NODE: { ret=ret->search(token); break; }
+   case zJSON::JSON_ARRAY: { ret=(pointer_index(n, token))?(ret->at(n)):(NULL); break; }
+   default: { return NULL; }
+  }
+  if(ret == NULL) return NULL;
+ }
+ return ret;
+};
+
+bool zJSON::patch(const zJSON& json_patch)
+{
+ if(json_patch.type() != zJSON::JSON_ARRAY) return false;
+ for(const zJSON* p=&json_patch; p != NULL; p=p->parent()) { if(p == this) return false; }
+ zjson_patch p(this);
+ for(size_t i=0; i < json_patch.size(); i++)
+ {
+  if(json_patch.at(i)->type() != zJSON::JSON_NODE || !p.apply(*json_patch.at(i))) { p.rollback(); return false; }
+ }
+ p.commit();
+ return true;
+};
+
+void zJSON::merge_patch(const zJSON& json_patch)
+{
+ if(&json_patch == this) return;
+ for(const zJSON* p=json_patch.parent(); p != NULL; p=p->parent())
+ {
+  if(p == this) { zJSON tmp(json_patch); merge_patch(tmp); return; }
+ }
+ if(json_patch.type() != zJSON::JSON_NODE)
+ {
+  zJSON tmp(json_patch);
+  swap_value(*this, tmp);
+  return;
+ }
+ if(type() != zJSON::JSON_NODE) create(zJSON::JSON_NODE, m_name);
+ const zJSON* src;
+ zJSON* p;
+ for(size_t i=0; i < json_patch.size(); i++)
+ {
+  src=json_patch.at(i);
+  if(src->type() == zJSON::JSON_NULL)
+  {
+   for(size_t n=find(src->name()); n != std::string::npos; n=find(src->name(), n)) erase(n);
+   continue;
+  }
+  p=search(src->name());
+  if(p != NULL) { p->merge_patch(*src); continue; }
+  if(src->type() != zJSON::JSON_NODE) { push_back(*src); continue; }
+  push_back(new zJSON(zJSON::JSON_NODE, src->name()))->merge_patch(*src);
+ }
+};
+
+static void replace_value(zJSON& dst, zJSON* src, bool own)
+{
+ if(own) { swap_value(dst, *src); return; }
+ zJSON tmp(*src);
+ swap_value(dst, tmp);
+};
+
+/*
+merge_value merges src into the object. If own is true the children of src are detached at once and every child is either
+transplanted or merged and destroyed, otherwise src is only read and the added objects are copied.
+*/
+void zJSON::merge_value(zJSON* src, bool own, const zJSON::zMergeJSON& opt)
+{
+ int t=src->type();
+ bool node=(t == zJSON::JSON_NODE);
+ if(node && opt.remove_nulls && type() != zJSON::JSON_NODE) create(zJSON::JSON_NODE, m_name);
+ if(t != type() || (!node && t != zJSON::JSON_ARRAY) || (!node && opt.arrays == zJSON::zMergeJSON::ARRAYS_REPLACE))
+ {
+  replace_value(*this, src, own);
+  return;
+ }
+ std::vector<zJSON*> v;
+ if(own) src->m_value->detach(v);
+ size_t n=(own)?(v.size()):(src->size());
+ zJSON* s;
+ zJSON* d;
+ for(size_t i=0; i < n; i++)
+ {
+  s=(own)?(v[i]):(src->at(i));
+  d=NULL;
+  if(node)
+  {
+   if(opt.remove_nulls && s->type() == zJSON::JSON_NULL)
+   {
+    for(size_t k=find(s->name()); k != std::string::npos; k=find(s->name(), k)) erase(k);
+    if(own) delete s;
+    continue;
+   }
+   if(opt.keys != zJSON::zMergeJSON::KEYS_APPEND) d=search(s->name());
+   if(d != NULL && opt.keys == zJSON::zMergeJSON::KEYS_KEEP) { if(own) delete s; continue; }
+   if(d != NULL && opt.keys == zJSON::zMergeJSON::KEYS_REPLACE) { replace_value(*d, s, own); if(own) delete s; continue; }
+   if(d == NULL && opt.remove_nulls && s->type() == zJSON::JSON_NODE) d=push_back(new zJSON(zJSON::JSON_NODE, s->name()));
+  }
+  else if(opt.arrays == zJSON::zMergeJSON::ARRAYS_MERGE) d=at(i);
+  if(d == NULL)
+  {
+   if(own) push_back(s); else push_back(*s);
+   continue;
+  }
+  d->merge_value(s, own, opt);
+  if(own) delete s;
+ }
+};
+
+static const zJSON* merge_root(const zJSON* p)
+{
+ for(; p->parent() != NULL; p=p->parent());
+ return p;
+};
+
+void zJSON::merge(const zJSON& src, const zJSON::zMergeJSON& opt)
+{
+ if(merge_root(this) == merge_root(&src))
+ {
+  zJSON tmp(src);
+  merge_value(&tmp, true, opt);
+  return;
+ }
+ merge_value(const_cast<zJSON*>(&src), false, opt);
+};
+
+bool zJSON::merge(zJSON* src, const zJSON::zMergeJSON& opt)
+{
+ if(src == NULL || src->m_parent != NULL || root(src) == src) return false;
+ merge_value(src, true, opt);
+ delete src;
+ return true;
+};
+
 
 
 
@@ -19,22 +19,38 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef __zJSON_h
 #define __zJSON_h 1
 
-#include <sstream>
-#include <string>
+#include <stdio.h>
+#include <sstream>
+#include <string>
 #include <vector>
 #include <set>
 #include <stdint.h>
 
-class zJSON
+#ifndef ZJSON_API
+#if defined(__GNUC__) && __GNUC__ >= 4 && !defined(_WIN32)
+#define ZJSON_API __attribute__((visibility("default")))
+#else
+#define ZJSON_API
+#endif
+#endif
+/*
+ZJSON_API marks the classes exported from the shared library. The shared library is compiled with -fvisibility=hidden, so
+the internal classes and functions of the library are not exported.
+*/
+
+class ZJSON_API zJSON
 {
  friend class zjson_base;
  friend class zjson_null;
  friend class zjson_bool;
  friend class zjson_integer;
  friend class zjson_number;
+ friend class zjson_raw_number;
  friend class zjson_string;
  friend class zjson_array;
  friend class zjson_node;
+ friend class zjson_builder;
+ friend class zjson_reuser;
 
 public:
 
@@ -61,7 +77,94 @@ static std::string toString(long double value);
 
 static double toDouble(const std::string &q, double def=0.0);
 static int64_t toInteger(const std::string &q, int64_t def=0);
+static void escape(std::string& ret, const char* src, size_t len);
+/*
+Appends src to ret escaped the same way as write does it for JSON_STRING (without quotes).
+*/
+static bool valid_utf8(const char* src, size_t len);
+static bool valid_utf8(const char* src, size_t len, size_t& res_pos);
+static bool valid_utf8(const std::string& src);
+static bool valid_utf8(const std::string& src, size_t& res_pos);
+/*
+Checks that src is well-formed UTF-8 (RFC 3629: no overlong forms, no surrogates, nothing above U+10FFFF), for example the
+result of write. res_pos is the offset of the first invalid sequence or std::string::npos.
+Returns true if successfully , false if unsuccessfully.
+*/
 
+struct Strict { enum { comments=0, concatenation=0, sign=0, trailing_commas=0, relaxed=0 }; };
+struct Extended { enum { comments=1, concatenation=1, sign=1, trailing_commas=1, relaxed=1 }; };
+/*
+Parser policies. Strict is the grammar of RFC 8259. Extended is the grammar of zJSON::parse: comments (#, // and block
+comments), concatenation of adjacent strings, leading '+' and blanks after the sign of number, trailing commas and relaxed
+syntax (optional commas, names of objects inside arrays and at the root, objects without names inside JSON_NODE, numbers like
+01 or 1., raw control characters and unknown escapes inside strings).
+*/
+class zOptionJSON
+{
+ public:
+  zOptionJSON():
+   max_depth(std::string::npos), max_string(std::string::npos), max_elements(std::string::npos),
+   max_nodes(std::string::npos), max_bytes(std::string::npos), utf8(false), raw_numbers(false) {};
+
+  size_t max_depth;
+  size_t max_string;
+  size_t max_elements;
+  size_t max_nodes;
+  size_t max_bytes;
+  bool utf8;
+  bool raw_numbers;
+};
+/*
+Limits of the input: max_depth is the maximum nesting of JSON_ARRAY and JSON_NODE, max_string is the maximum size of string
+or name in bytes of JSON text (adjacent strings are counted together), max_elements is the maximum number of children of one
+JSON_ARRAY or JSON_NODE, max_nodes is the maximum number of all objects, max_bytes is the maximum size of the value in bytes
+of JSON text. By default there are no limits.
+utf8 checks that the strings and names are well-formed UTF-8 while they are scanned (the check is vectorized when the CPU
+supports SSSE3); by default the bytes are passed through unchecked.
+raw_numbers keeps the source text of the numbers written in the strict grammar: the number is converted on the first access
+(as_integer, as_number, ptr_integer, ptr_number or the comparison) and the result is cached, write emits the source text
+as is (the precision of the number is not lost and the number is not formatted). By default the numbers are converted by the
+parser.
+*/
+class zErrorJSON
+{
+ public:
+  enum
+  {
+   ERROR_NONE=0,
+   ERROR_EOF,
+   ERROR_TOKEN,
+   ERROR_NAME,
+   ERROR_STRING,
+   ERROR_NUMBER,
+   ERROR_SEPARATOR,
+   ERROR_DEPTH,
+   ERROR_STRING_LIMIT,
+   ERROR_ELEMENTS_LIMIT,
+   ERROR_NODES_LIMIT,
+   ERROR_BYTES_LIMIT,
+   ERROR_UTF8,
+   ERROR_READ
+  };
+
+  zErrorJSON(): code(ERROR_NONE), offset(0), line(0), column(0) {};
+
+  void clear() { code=ERROR_NONE; offset=0; line=0; column=0; path.clear(); };
+  const char* reason() const;
+  std::string message() const;
+
+  int code;
+  size_t offset;
+  size_t line;
+  size_t column;
+  std::string path;
+};
+/*
+Description of the parse error: code, byte offset of the error in the text, line and column (both start at 1, column is
+counted in bytes), path is JSON pointer (RFC 6901) to the value which contains the error. reason returns the text of the code,
+message returns the full description like "unexpected character at line 3, column 7 (offset 42) in /a/0".
+The error is recorded by the parser where it stops, so the successful parse costs nothing.
+*/
 static zJSON* parse(const char* src, size_t len, size_t start_pos=0);
 static zJSON* parse(const std::string& src, size_t start_pos=0);
 static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos);
@@ -70,10 +173,85 @@ static bool parse(zJSON& ret, const char* src, size_t len, size_t start_pos=0);
 static bool parse(zJSON& ret, const std::string& src, size_t start_pos=0);
 static bool parse(zJSON& ret, const char* src, size_t len, size_t start_pos, size_t& res_pos);
 static bool parse(zJSON& ret, const std::string& src, size_t start_pos, size_t& res_pos);
+template <class P> static zJSON* parse(const char* src, size_t len, size_t start_pos=0);
+template <class P> static zJSON* parse(const std::string& src, size_t start_pos=0);
+template <class P> static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos);
+template <class P> static zJSON* parse(const char* src, size_t len, size_t start_pos, size_t& res_pos);
+template <class P> static bool parse(zJSON& ret, const char* src, size_t len, size_t start_pos=0);
+template <class P> static bool parse(zJSON& ret, const std::string& src, size_t start_pos=0);
+template <class P> static bool parse(zJSON& ret, const char* src, size_t len, size_t start_pos, size_t& res_pos);
+template <class P> static bool parse(zJSON& ret, const std::string& src, size_t start_pos, size_t& res_pos);
+static zJSON* parse(const char* src, size_t len, size_t start_pos, size_t& res_pos, const zOptionJSON& opt);
+static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos, const zOptionJSON& opt);
+static zJSON* parse(const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static zJSON* parse(const char* src, size_t len, size_t start_pos, size_t& res_pos, const zOptionJSON& opt);
+template <class P> static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos, const zOptionJSON& opt);
+template <class P> static zJSON* parse(const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static zJSON* parse(const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
 /*
 Parses JSON text src start at start_pos and returns the JSON object which is the root.
-The function returns pointer or reference(ret) to the JSON object.
-If error occurrence NULL will be return and true  successfully , false  unsuccessfully.
+The function returns pointer or reference(ret) to the JSON object. The template versions use the policy P (zJSON::Strict or
+zJSON::Extended), the others use zJSON::Extended. The parser does not use recursion, so any nesting is parsed with the same
+stack; opt limits the depth, the number of objects and the size of the input.
+If error occurrence NULL will be return (err describes the error) and true  successfully , false  unsuccessfully.
+*/
+static bool parse_into(zJSON& ret, const char* src, size_t len, size_t start_pos=0);
+static bool parse_into(zJSON& ret, const std::string& src, size_t start_pos=0);
+static bool parse_into(zJSON& ret, const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+static bool parse_into(zJSON& ret, const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool parse_into(zJSON& ret, const char* src, size_t len, size_t start_pos=0);
+template <class P> static bool parse_into(zJSON& ret, const std::string& src, size_t start_pos=0);
+template <class P> static bool parse_into(zJSON& ret, const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool parse_into(zJSON& ret, const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+/*
+Parses JSON text src into ret reusing its objects: the object at the same position of the same container is overwritten in
+place if it has the same type (the strings keep their capacity, the containers keep their elements), the other objects are
+replaced and the elements left over are destroyed. Parsing the document of the same shape again allocates nothing except
+the strings which grow. param of the reused objects are kept.
+If error occurrence ret becomes JSON_NULL (the old tree is destroyed) and false is returned.
+*/
+static bool validate(const char* src, size_t len, size_t start_pos=0, const zOptionJSON& opt=zOptionJSON());
+static bool validate(const char* src, size_t len, size_t start_pos, size_t& res_pos, const zOptionJSON& opt=zOptionJSON());
+static bool validate(const std::string& src, size_t start_pos=0, const zOptionJSON& opt=zOptionJSON());
+static bool validate(const std::string& src, size_t start_pos, size_t& res_pos, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const char* src, size_t len, size_t start_pos=0, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const char* src, size_t len, size_t start_pos, size_t& res_pos, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const std::string& src, size_t start_pos=0, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const std::string& src, size_t start_pos, size_t& res_pos, const zOptionJSON& opt=zOptionJSON());
+static bool validate(const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+static bool validate(const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const char* src, size_t len, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+template <class P> static bool validate(const std::string& src, size_t start_pos, size_t& res_pos, zErrorJSON& err, const zOptionJSON& opt=zOptionJSON());
+/*
+Checks JSON text src start at start_pos the same way as parse does it, but without creating of JSON objects and without
+memory allocation. res_pos is set to the position after the value.
+Returns true if successfully , false if unsuccessfully (the text is malformed or exceeds the limits opt), err describes
+the error.
+*/
+static bool scan_blank(const char* src, size_t len, size_t& pos);
+static bool scan_name(std::string& ret, const char* src, size_t len, size_t& pos);
+static bool scan_string(std::string& ret, const char* src, size_t len, size_t& pos);
+static int scan_number(int64_t& integer, double& number, const char* src, size_t len, size_t& pos);
+static int scan_literal(bool& value, const char* src, size_t len, size_t& pos);
+static bool skip(const char* src, size_t len, size_t& pos);
+/*
+Token level reading of JSON text src start at pos without creating of JSON objects. The functions skip blanks and comments
+before the token and on success move pos past the token, on failure pos is not changed.
+scan_blank skips blanks and comments, returns false if the end of src is reached.
+scan_name reads the object name with the following ':'. scan_string reads the string (adjacent strings are concatenated).
+scan_number returns JSON_INTEGER or JSON_NUMBER and sets both integer and number, scan_literal returns JSON_NULL or
+JSON_BOOLEAN (value is set for JSON_BOOLEAN), both return -1 if the token is not found.
+skip passes over the whole value (with its name if any) the same way as parse does it.
+*/
+static zJSON* parse_cbor(const char* src, size_t len, size_t start_pos=0);
+static zJSON* parse_cbor(const char* src, size_t len, size_t start_pos, size_t& res_pos);
+static zJSON* parse_msgpack(const char* src, size_t len, size_t start_pos=0);
+static zJSON* parse_msgpack(const char* src, size_t len, size_t start_pos, size_t& res_pos);
+/*
+Parses binary CBOR (RFC 7049) or MessagePack data src start at start_pos and returns the JSON object which is the root.
+Map keys become object names (the same names and their order are preserved), integers become JSON_INTEGER, floating point
+values become JSON_NUMBER, text and byte strings become JSON_STRING. If error occurrence NULL will be return.
 */
  explicit zJSON(int json_type = zJSON::JSON_NODE, const std::string& json_name="");
  void create(int json_type = zJSON::JSON_NODE, const std::string& json_name="");
@@ -223,6 +401,12 @@ Returns true if successfully , false if unsuccessfully.
  std::string* ptr_string() { return m_value->ptr_string(); };
 /*
 Returns pointer to plain types from JSON object. If plain types is not found the function returns NULL.
+*/
+ const std::string* ptr_raw() const { return m_value->ptr_raw(); };
+/*
+Returns pointer to the source text of JSON_INTEGER or JSON_NUMBER which is parsed with zOptionJSON::raw_numbers (or is
+assigned from uint64_t greater than INT64_MAX). The function returns NULL for other objects and after the value is changed
+through ptr_integer or ptr_number.
 */
  bool as_boolean() const { return m_value->as_boolean(); };
  int64_t as_integer() const { return m_value->as_integer(); };
@@ -248,6 +432,32 @@ Returns a pointer to the first element. If element is not found the function ret
  zJSON* back() { return m_value->back(); };
 /*
 Returns a pointer to the last element. If element is not found the function returns NULL.
+*/
+ typedef zJSON* const* iterator;
+ typedef const zJSON* const* const_iterator;
+ iterator begin() { size_t n; return m_value->children(n); };
+ iterator end() { size_t n; zJSON* const* p=m_value->children(n); return p+n; };
+ const_iterator begin() const { size_t n; return m_value->children(n); };
+ const_iterator end() const { size_t n; zJSON* const* p=m_value->children(n); return p+n; };
+/*
+Random access iterators over the elements of JSON_ARRAY or JSON_NODE (the range is empty for other types), for example
+for(zJSON::iterator i=p->begin(); i != p->end(); ++i) or for(zJSON* e : *p). The elements are walked without a call per
+element. The iterator points to the pointer to the element and is invalidated by any change of the elements (insert, erase...).
+*/
+ class zVisitorJSON
+ {
+  public:
+   bool enter(const zJSON& p, size_t depth) { return true; };
+   void leave(const zJSON& p, size_t depth) { return; };
+ };
+ template <class V> void visit(V& visitor);
+ template <class V> void visit(V& visitor) const;
+/*
+Depth-first traversal of the object and all its descendants without recursion. visitor.enter(p, depth) is called before the
+elements of p (pre-order, depth of the object is 0) and returns false to skip the elements of p, visitor.leave(p, depth) is
+called after them (post-order). V is any class with these functions (zVisitorJSON gives both, so the derived class defines
+only what it needs); they are not virtual, so the compiler can inline them. The elements must not be inserted or removed
+during the traversal.
 */
  zJSON* root() { if(m_parent == NULL) return this; return m_parent->root(); };
  zJSON* root(zJSON* prn) { if(m_parent == NULL) return this; if(m_parent == prn) return prn; return m_parent->root(prn); };
@@ -275,6 +485,10 @@ Returns the number of children that the object has. The function returns 0 for a
  void clear() { return m_value->clear(); };
 /*
 Removes all elements from the object (which are destroyed), leaving the container with a size of 0.
+*/
+ void reserve(size_t n) { m_value->reserve(n); };
+/*
+Requests that the object (JSON_ARRAY or JSON_NODE) capacity be at least enough to contain n elements.
 */
  zJSON* insert(size_t pos, const zJSON& val) { return m_value->insert(pos, val, this); };
  zJSON* insert(size_t pos, zJSON* val) { return m_value->insert(pos, val, this); };
@@ -304,13 +518,343 @@ This effectively reduces the container size by the one element, which are destro
 Removes the last element in the object, effectively reducing the container size by one.
 This destroys the removed element.
 */
- void write(std::string& ret) const { m_value->write(ret, this); };
+ zJSON* pointer(const std::string& path) const;
+/*
+Returns pointer to the object referenced by JSON Pointer path (RFC 6901), for example "/a/b/0". The empty path references
+this object. If object is not found the function returns NULL.
+*/
+ bool patch(const zJSON& json_patch);
+/*
+Applies JSON Patch json_patch (RFC 6902, array of operations) to the object in place. Operation "move" transplants the
+object (see remove, insert) without copying. If any operation fails all changes are rolled back and the function returns false.
+Returns true if successfully , false if unsuccessfully.
+*/
+ void merge_patch(const zJSON& json_patch);
+/*
+Applies JSON Merge Patch json_patch (RFC 7396) to the object in place. Members with null value are removed from the object.
+*/
+ class zMergeJSON
+ {
+  public:
+   enum { ARRAYS_REPLACE=0, ARRAYS_CONCAT, ARRAYS_MERGE };
+   enum { KEYS_MERGE=0, KEYS_REPLACE, KEYS_KEEP, KEYS_APPEND };
+   zMergeJSON(): arrays(ARRAYS_REPLACE), keys(KEYS_MERGE), remove_nulls(false) {};
+
+   int arrays;
+   int keys;
+   bool remove_nulls;
+ };
+/*
+Policies of merge. arrays: ARRAYS_REPLACE replaces JSON_ARRAY by the source one, ARRAYS_CONCAT appends the source elements,
+ARRAYS_MERGE merges the elements with the same index and appends the rest. keys is used for the source member whose name is
+already in JSON_NODE (the first member with the name): KEYS_MERGE merges the values, KEYS_REPLACE replaces the value by the
+source one, KEYS_KEEP keeps the value of the object, KEYS_APPEND adds the source member as the duplicate name.
+remove_nulls removes the members which have the same name as the source member with null value, like merge_patch does.
+By default JSON_NODE is merged by names recursively and everything else is replaced.
+*/
+ void merge(const zJSON& src, const zMergeJSON& opt=zMergeJSON());
+ bool merge(zJSON* src, const zMergeJSON& opt=zMergeJSON());
+/*
+Deep merge of src into the object in place (see zMergeJSON). The name of the object is kept, so layers are merged in order:
+defaults.merge(region); defaults.merge(host); ...
+At the first function the copies of the added objects will be created. At the second function the object src is consumed:
+its subtrees are transplanted (see remove, insert) without copying and src is destroyed. src can be consumed if its parent is
+NULL and it does not contain the object.
+Returns true if successfully , false if unsuccessfully.
+*/
+ void write(std::string& ret) const;
 /*
 Returns JSON text, with no white space.
 */
- void write_formatted(std::string& ret) const { m_value->write_formatted(ret, this, 0); };
+ class zFormatJSON
+ {
+  public:
+   zFormatJSON(): indent(1), tabs(false), compact_arrays(false) {};
+
+   size_t indent;
+   bool tabs;
+   bool compact_arrays;
+ };
+/*
+Layout of write_formatted: indent is the number of characters per level of nesting, tabs indents with '\t' instead of ' ',
+compact_arrays writes JSON_ARRAY which contains only plain values (no JSON_ARRAY or JSON_NODE) in one line like a plain value.
+By default one space per level and every value in its own line.
+*/
+ void write_formatted(std::string& ret) const;
+ void write_formatted(std::string& ret, const zFormatJSON& fmt) const;
 /*
 Returns JSON text that has been indented and prettied up so that it can be easily read and modified by humans.
+*/
+ class zSinkJSON
+ {
+  public:
+   zSinkJSON() {};
+   virtual ~zSinkJSON() { return; };
+   virtual bool write(const char* data, size_t len)=0;
+ };
+/*
+Destination of the streaming writer. write receives the next part of JSON text and returns false to stop the writing.
+*/
+ bool write(zSinkJSON& sink, size_t buffer_size=65536) const;
+ bool write(std::ostream& os, size_t buffer_size=65536) const;
+ bool write(FILE* f, size_t buffer_size=65536) const;
+ bool write(int fd, size_t buffer_size=65536) const;
+ bool write_formatted(zSinkJSON& sink, size_t buffer_size=65536, const zFormatJSON& fmt=zFormatJSON()) const;
+ bool write_formatted(std::ostream& os, size_t buffer_size=65536, const zFormatJSON& fmt=zFormatJSON()) const;
+ bool write_formatted(FILE* f, size_t buffer_size=65536, const zFormatJSON& fmt=zFormatJSON()) const;
+ bool write_formatted(int fd, size_t buffer_size=65536, const zFormatJSON& fmt=zFormatJSON()) const;
+/*
+Writes the same text as write and write_formatted to the sink, the stream, the file or the file descriptor. The text is
+collected in the buffer of buffer_size bytes which is passed on every time it is full, so the memory does not depend on the
+size of the tree (only a single value longer than the buffer makes it grow). The tree is walked without recursion.
+Returns true if successfully , false if unsuccessfully (the destination failed, the text may be written partially).
+*/
+ void write_parallel(std::string& ret, size_t threads=0) const;
+ bool write_parallel(zSinkJSON& sink, size_t threads=0) const;
+/*
+Writes the same text as write using threads threads (0 is the number of processors). The large containers are split into
+chunks of children which are written by the threads into separate buffers, the buffers are appended to ret or passed to the
+sink in order as soon as the preceding text is written. The text is byte-identical to write. The tree of less than 8192
+objects is written by one thread like write. Other threads must not change the tree while it is written.
+Returns true if successfully , false if unsuccessfully (the sink failed, the text may be written partially).
+*/
+ void write_canonical(std::string& ret) const;
+ bool write_canonical(zSinkJSON& sink, size_t buffer_size=65536) const;
+/*
+Writes the canonical JSON text (RFC 8785, JSON Canonicalization Scheme): no white space, the members of every JSON_NODE are
+sorted by name (UTF-16 code units, the members with the same name keep their order), the numbers are written in the shortest
+form which reads back to the same double (JSON_INTEGER beyond 2^53 is written as the double), the strings are escaped only
+where JSON requires it. The same data always gives the same bytes, so the text may be hashed or signed. The names of the root
+and of the elements of JSON_ARRAY are not written, NaN and infinity are written as null. The children are sorted through the
+array of pointers (the tree is not changed), the text is collected in ret or in the buffer of buffer_size bytes like write.
+Returns true if successfully , false if unsuccessfully (the sink failed, the text may be written partially).
+*/
+ class zSourceJSON
+ {
+  public:
+   zSourceJSON() {};
+   virtual ~zSourceJSON() { return; };
+   virtual long read(char* data, size_t len)=0;
+ };
+/*
+Source of the streaming reader. read places up to len bytes of the next part of JSON text to data and returns the number of
+bytes, 0 at the end of the text or -1 if the source failed.
+*/
+ class zFileJSON: public zSinkJSON, public zSourceJSON
+ {
+  public:
+   zFileJSON(FILE* f): m_file(f), m_fd(-1) {};
+   zFileJSON(int fd): m_file(NULL), m_fd(fd) {};
+   virtual bool write(const char* data, size_t len);
+   virtual long read(char* data, size_t len);
+
+  private:
+   FILE* m_file;
+   int m_fd;
+ };
+/*
+Sink and source on the opened file or file descriptor (the file is not closed by zFileJSON).
+*/
+ class zReaderJSON
+ {
+  public:
+   zReaderJSON(zSourceJSON& src, const zOptionJSON& opt=zOptionJSON(), size_t block_size=65536);
+
+   zJSON* next();
+   zJSON* next(zErrorJSON& err);
+   bool eof() const { return (m_end && m_pos == m_buffer.size()); };
+   size_t offset() const { return m_offset+m_pos; };
+
+  private:
+   zSourceJSON& m_src;
+   zOptionJSON m_opt;
+   size_t m_block;
+   std::string m_buffer;
+   size_t m_pos;
+   size_t m_offset;
+   size_t m_line;
+   size_t m_column;
+   bool m_end;
+   zErrorJSON m_error;
+
+   bool fill();
+   zReaderJSON(const zReaderJSON& src);
+   zReaderJSON& operator=(const zReaderJSON& src);
+ };
+/*
+Streaming reader: parses JSON values (one JSON document, NDJSON or values separated by blanks) from the source one by one.
+The text is read by blocks of block_size bytes and only the part of the text which contains the current value is kept in
+memory (the value longer than the block makes the buffer grow). next returns the next value or NULL at the end of the text
+or if error occurrence (err describes the error: offset, line and column are counted from the start of the text,
+ERROR_READ if the source failed; after the error next returns NULL with the same error). The value is
+returned and the error is reported only when the following text can not change them (for example the string which is
+followed by the next string is read up to the end of the concatenation), so the result does not depend on block_size. eof
+returns true when the text is read up to the end, offset returns the number of bytes of the text which are parsed.
+*/
+ template <class P=zJSON::Extended> class zCursorJSON
+ {
+  public:
+   enum { TOKEN_END=0, TOKEN_ERROR, TOKEN_NAME, TOKEN_NULL, TOKEN_BOOLEAN, TOKEN_INTEGER, TOKEN_NUMBER, TOKEN_STRING,
+          TOKEN_BEGIN_ARRAY, TOKEN_END_ARRAY, TOKEN_BEGIN_NODE, TOKEN_END_NODE };
+
+   zCursorJSON(const char* src, size_t len, size_t start_pos=0, const zOptionJSON& opt=zOptionJSON());
+
+   int next();
+   bool skip();
+   int token() const { return m_token; };
+   size_t depth() const { return m_depth; };
+   const char* text() const { return m_text; };
+   size_t length() const { return m_length; };
+   std::string str() const { return std::string(m_text, m_length); };
+   bool boolean() const { return m_boolean; };
+   int64_t integer() const { return m_integer; };
+   double number() const { return (m_token == TOKEN_INTEGER)?((double) m_integer):(m_number); };
+   size_t offset() const { return m_pos; };
+   const zErrorJSON& error() const { return m_error; };
+
+  private:
+   struct zjson_cursor_frame
+   {
+    char end;
+    size_t count;
+    size_t name;
+   };
+   enum { __local_frames__=32 };
+
+   const char* m_src;
+   size_t m_len;
+   size_t m_full;
+   size_t m_pos;
+   zOptionJSON m_opt;
+   bool m_skip;
+   int m_state;
+   int m_token;
+   int m_last;
+   size_t m_nodes;
+   size_t m_depth;
+   zjson_cursor_frame m_local[__local_frames__];
+   std::vector<zjson_cursor_frame> m_more;
+   const char* m_text;
+   size_t m_length;
+   std::string m_buffer;
+   bool m_boolean;
+   int64_t m_integer;
+   double m_number;
+   zErrorJSON m_error;
+
+   zjson_cursor_frame& frame(size_t pos) { return (pos < __local_frames__)?(m_local[pos]):(m_more[pos-__local_frames__]); };
+   void push(char end);
+   int close(size_t pos);
+   int fail(int code, size_t at, bool inside);
+   void string_text(size_t start, size_t end, bool concatenated);
+   zCursorJSON(const zCursorJSON& src);
+   zCursorJSON& operator=(const zCursorJSON& src);
+ };
+/*
+Pull parser: reads JSON text src (one value starting at start_pos, like parse) token by token without building the tree.
+next returns the next token: TOKEN_NAME (the name of the member, then the token of its value follows), the plain values,
+TOKEN_BEGIN_ARRAY, TOKEN_END_ARRAY, TOKEN_BEGIN_NODE, TOKEN_END_NODE, TOKEN_END at the end of the value or TOKEN_ERROR
+(error describes the error, next keeps returning TOKEN_ERROR). skip passes over the whole value: after TOKEN_NAME the value
+of the member, after TOKEN_BEGIN_ARRAY or TOKEN_BEGIN_NODE the rest of the container; returns false if error occurrence.
+The grammar is the policy P like in the template versions of parse: zCursorJSON<> reads zJSON::Extended (comments,
+concatenation of strings, ...), zCursorJSON<zJSON::Strict> reads RFC 8259; opt limits the input like parse does. The cursor can be abandoned at any token.
+text and length return the name or the string (unescaped) or the source text of the other tokens, boolean, integer and
+number return the value of the plain token. The text points into src unless the string has escapes or is concatenated, then
+it is unescaped into the buffer of the cursor (valid until the next call); this is the only allocation, besides the depth
+beyond 32 levels. depth is the number of the open containers, offset is the position in src after the current token.
+*/
+#if defined(ZJSON_ZLIB) || defined(ZJSON_ZSTD)
+ enum { COMPRESS_GZIP=0, COMPRESS_ZSTD };
+
+ class zCompressSinkJSON: public zSinkJSON
+ {
+  public:
+   zCompressSinkJSON(zSinkJSON& dst, int format=COMPRESS_GZIP, int level=-1, size_t block_size=262144);
+   virtual ~zCompressSinkJSON();
+   virtual bool write(const char* data, size_t len);
+   bool close();
+
+  private:
+   void* m_pipe;
+   std::string m_block;
+   size_t m_block_size;
+   bool m_failed;
+
+   zCompressSinkJSON(const zCompressSinkJSON& src);
+   zCompressSinkJSON& operator=(const zCompressSinkJSON& src);
+ };
+ class zDecompressSourceJSON: public zSourceJSON
+ {
+  public:
+   zDecompressSourceJSON(zSourceJSON& src, size_t block_size=262144);
+   virtual ~zDecompressSourceJSON();
+   virtual long read(char* data, size_t len);
+
+  private:
+   void* m_pipe;
+   std::string m_block;
+   size_t m_block_size;
+   size_t m_pos;
+   int m_state;
+
+   zDecompressSourceJSON(const zDecompressSourceJSON& src);
+   zDecompressSourceJSON& operator=(const zDecompressSourceJSON& src);
+ };
+/*
+Compressed input and output, built when the library is compiled with ZJSON_ZLIB (gzip, link with -lz) and/or ZJSON_ZSTD
+(zstd, link with -lzstd), for example make DEFS="-DZJSON_ZLIB -DZJSON_ZSTD" LIBS="-lz -lzstd -lpthread".
+zCompressSinkJSON compresses the text written to it (by write, write_formatted or write_parallel) in format with level
+(-1 is the default level of the format) and passes the compressed data to dst; close finishes the compressed stream and
+returns false if dst failed (the destructor calls close).
+zDecompressSourceJSON reads gzip or zstd data (the format is detected by the first bytes, other text is passed unchanged,
+concatenated gzip members and zstd frames are read as one text) from src, for example for zReaderJSON.
+Both classes run the compression in their own thread, so the compression and the writer or the decompression and the parser
+use two processors; the data are passed by blocks of block_size bytes and at most two blocks are queued, so the memory does
+not depend on the size of the text.
+*/
+#endif
+#ifdef ZJSON_STATS
+ class zStatsJSON
+ {
+  public:
+   enum { PHASE_PARSE=0, PHASE_VALIDATE, PHASE_WRITE, PHASES };
+
+   void clear();
+   void add(const zStatsJSON& src);
+
+   uint64_t nodes[JSON_NODE+1];
+   uint64_t bytes;
+   uint64_t allocations;
+   uint64_t allocated;
+   uint64_t max_depth;
+   uint64_t calls[PHASES];
+   uint64_t time[PHASES];
+ };
+/*
+Statistics of parse, validate and write (including write_formatted and the streaming writer). They are collected only when
+the library is built with ZJSON_STATS defined (make DEFS=-DZJSON_STATS), otherwise the code is compiled out.
+nodes is the number of objects by type (nodes[JSON_STRING] etc.), bytes is the size of JSON text scanned or written,
+allocations and allocated are the number and the size in bytes of memory blocks allocated for the tree by parse, max_depth is
+the maximum nesting, calls and time are the number of calls and the time in nanoseconds of every phase.
+*/
+ typedef void (*zStatsHookJSON)(int phase, const zStatsJSON& call, void* arg);
+static const zStatsJSON& last_stats();
+static const zStatsJSON& thread_stats();
+static void reset_stats();
+static void stats_hook(zStatsHookJSON hook, void* arg=NULL);
+/*
+last_stats returns the statistics of the last call in the current thread, thread_stats the sum of all calls in the current
+thread since the start of the thread or reset_stats. The hook (one for all threads, it should be set before the threads are
+started) is called in the calling thread at the end of every call with the phase and its statistics, for example to export
+them to the metrics system. The hook must not call parse, validate or write.
+*/
+#endif
+ void write_cbor(std::string& ret) const;
+ void write_msgpack(std::string& ret) const;
+/*
+Appends binary CBOR or MessagePack representation of the object to ret. JSON_INTEGER is written as the shortest integer
+(unsigned up to UINT64_MAX, the integer which does not fit the format is written as float64 with the nearest value),
+JSON_NUMBER as float64, names of JSON_NODE children as map keys.
 */
 
  class zParamJSON
@@ -352,6 +896,7 @@ protected:
    virtual int64_t* ptr_integer()=0;
    virtual double* ptr_number()=0;
    virtual std::string* ptr_string()=0;
+   virtual const std::string* ptr_raw() { return NULL; };
 
    virtual bool as_boolean() const=0;
    virtual int64_t as_integer() const=0;
@@ -373,6 +918,7 @@ protected:
    virtual size_t size() const=0;
 
    virtual void clear()=0;
+   virtual void reserve(size_t n)=0;
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn)=0;
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn)=0;
    virtual zJSON* push_back(const zJSON& val, zJSON* prn)=0;
@@ -380,9 +926,9 @@ protected:
    virtual bool erase(size_t pos)=0;
    virtual bool pop_back()=0;
    virtual zJSON* remove(zJSON* p)=0;
+   virtual void detach(std::vector<zJSON*>& ret) { return; };
+   virtual zJSON* const* children(size_t& n) const { n=0; return NULL; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const=0;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const=0;
 
   private:
   zjson_base(const zjson_base& src);
@@ -391,6 +937,17 @@ protected:
 
 mutable zJSON::zjson_base* m_value;
 
+ zJSON(const std::string& json_name, zJSON::zjson_base* json_value): param(NULL), m_parent(NULL), m_name(json_name), m_value(json_value) {};
+ void merge_value(zJSON* src, bool own, const zJSON::zMergeJSON& opt);
+
+ template <class T> struct zjson_visit_frame
+ {
+  T* p;
+  T* const* pos;
+  T* const* end;
+ };
+ template <class T, class V> static void visit_tree(T* root, V& visitor);
+
  class zjson_null: public zJSON::zjson_base
  {
   public:
@@ -425,6 +982,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return 0; };
 
    virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
    virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
@@ -433,8 +991,6 @@ mutable zJSON::zjson_base* m_value;
    virtual bool pop_back() { return NULL; };
    virtual zJSON* remove(zJSON* p) { return p; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
  };
 
  class zjson_bool: public zJSON::zjson_base
@@ -471,6 +1027,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return 0; };
 
    virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
    virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
@@ -479,8 +1036,6 @@ mutable zJSON::zjson_base* m_value;
    virtual bool pop_back() { return NULL; };
    virtual zJSON* remove(zJSON* p) { return p; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    bool value;
@@ -520,6 +1075,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return 0; };
 
    virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
    virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
@@ -528,8 +1084,6 @@ mutable zJSON::zjson_base* m_value;
    virtual bool pop_back() { return NULL; };
    virtual zJSON* remove(zJSON* p) { return p; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    int64_t value;
@@ -569,6 +1123,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return 0; };
 
    virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
    virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
@@ -577,13 +1132,81 @@ mutable zJSON::zjson_base* m_value;
    virtual bool pop_back() { return NULL; };
    virtual zJSON* remove(zJSON* p) { return p; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    double value;
  };
 
+ class zjson_raw_number: public zJSON::zjson_base
+ {
+  public:
+   zjson_raw_number(const char* s, size_t n, int t): zJSON::zjson_base(), text(s, n), kind(t), ready(0), wide(0.0) { value.integer=0; original.integer=0; };
+   virtual ~zjson_raw_number() { return; };
+   void assign(const char* s, size_t n, int t) { text.assign(s, n); kind=t; ready=0; };
+   virtual zJSON::zjson_base* copy(zJSON* prn) const;
+   virtual int type() const { return kind; };
+   virtual void set_parent(zJSON* p) { return; };
+
+   virtual bool* ptr_boolean() { return NULL; };
+   virtual int64_t* ptr_integer() { if(kind != zJSON::JSON_INTEGER) return NULL; convert(); return &value.integer; };
+   virtual double* ptr_number() { if(kind != zJSON::JSON_NUMBER) return NULL; convert(); return &value.number; };
+   virtual std::string* ptr_string() { return NULL; };
+   virtual const std::string* ptr_raw() { return (changed())?(NULL):(&text); };
+
+   virtual bool as_boolean() const { convert(); return (kind == zJSON::JSON_INTEGER)?(value.integer != 0):((bool) value.number); };
+   virtual int64_t as_integer() const { convert(); return (kind == zJSON::JSON_INTEGER)?(value.integer):((int64_t) value.number); };
+   virtual double as_number() const;
+   virtual std::string as_string() const { std::string ret; as_string(ret); return ret; };
+   virtual bool as_string(std::string& ret) const;
+
+   virtual const zJSON* at(size_t pos) const { return NULL; };
+   virtual zJSON* at(size_t pos) { return NULL; };
+   virtual const zJSON* front() const { return NULL; };
+   virtual zJSON* front() { return NULL; };
+   virtual const zJSON* back() const { return NULL; };
+   virtual zJSON* back() { return NULL; };
+   virtual size_t index(const zJSON* const p) const { return std::string::npos; };
+   virtual size_t find(const std::string& json_name, size_t start_pos) const { return std::string::npos; };
+   virtual zJSON* search(const std::string& json_name, size_t start_pos) const { return NULL; };
+  
+   virtual bool empty() const { return true; };
+   virtual size_t size() const { return 0; };
+
+   virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
+   virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
+   virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
+   virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
+   virtual zJSON* push_back(zJSON* val, zJSON* prn) { return NULL; };
+   virtual bool erase(size_t pos) { return NULL; };
+   virtual bool pop_back() { return NULL; };
+   virtual zJSON* remove(zJSON* p) { return p; };
+
+
+  protected:
+   union zjson_raw_value
+   {
+    int64_t integer;
+    double number;
+   };
+
+   std::string text;
+   int kind;
+   mutable int ready;
+   mutable zjson_raw_value value;
+   mutable zjson_raw_value original;
+   mutable double wide;
+
+   void convert() const;
+   bool changed() const;
+ };
+/*
+zjson_raw_number is JSON_INTEGER or JSON_NUMBER which keeps its source text (zOptionJSON::raw_numbers). The text is
+converted on the first access, the original value is kept to find out whether the value is changed through the pointer.
+wide is the double of JSON_INTEGER which is read from the text when the integer does not fit int64_t. ready is 0 before
+the conversion, 1 while a thread converts and 2 after it (atomic), so the const accessors may be called concurrently.
+*/
+
  class zjson_string: public zJSON::zjson_base
  {
   public:
@@ -619,6 +1242,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return 0; };
 
    virtual void clear() { return; };
+   virtual void reserve(size_t n) { return; };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn) { return NULL; };
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn) { return NULL; };
    virtual zJSON* push_back(const zJSON& val, zJSON* prn) { return NULL; };
@@ -627,15 +1251,19 @@ mutable zJSON::zjson_base* m_value;
    virtual bool pop_back() { return NULL; };
    virtual zJSON* remove(zJSON* p) { return p; };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    std::string  value;
  };
 
+ class zjson_node;
+
  class zjson_array: public zJSON::zjson_base
  {
+  friend class zjson_builder;
+  friend class zjson_reuser;
+  friend class zjson_node;
+
   public:
    zjson_array(): zJSON::zjson_base(), value() { };
    zjson_array(const std::vector<zJSON*>& v, zJSON* prn);
@@ -669,6 +1297,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return value.size(); };
 
    virtual void clear();
+   virtual void reserve(size_t n) { value.reserve(n); };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn);
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn);
    virtual zJSON* push_back(const zJSON& val, zJSON* prn);
@@ -676,16 +1305,22 @@ mutable zJSON::zjson_base* m_value;
    virtual bool erase(size_t pos);
    virtual bool pop_back();
    virtual zJSON* remove(zJSON* p);
+   virtual void detach(std::vector<zJSON*>& ret);
+   virtual zJSON* const* children(size_t& n) const { n=value.size(); return (n)?(&value[0]):(NULL); };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    std::vector<zJSON*> value;
+
+   static void release(std::vector<zJSON*>& v);
  };
 
  class zjson_node: public zJSON::zjson_base
  {
+  friend class zjson_builder;
+  friend class zjson_reuser;
+  friend class zjson_array;
+
   public:
    zjson_node(): zJSON::zjson_base(), value() { };
    zjson_node(const std::vector<zJSON*>& v, zJSON* prn);
@@ -719,6 +1354,7 @@ mutable zJSON::zjson_base* m_value;
    virtual size_t size() const { return value.size(); };
 
    virtual void clear();
+   virtual void reserve(size_t n) { value.reserve(n); };
    virtual zJSON* insert(size_t pos, const zJSON& val, zJSON* prn);
    virtual zJSON* insert(size_t pos, zJSON* val, zJSON* prn);
    virtual zJSON* push_back(const zJSON& val, zJSON* prn);
@@ -726,9 +1362,9 @@ mutable zJSON::zjson_base* m_value;
    virtual bool erase(size_t pos);
    virtual bool pop_back();
    virtual zJSON* remove(zJSON* p);
+   virtual void detach(std::vector<zJSON*>& ret);
+   virtual zJSON* const* children(size_t& n) const { n=value.size(); return (n)?(&value[0]):(NULL); };
 
-   virtual void write(std::string& ret, const zJSON* const prn) const;
-   virtual void write_formatted(std::string& ret, const zJSON* const prn, size_t level) const;
 
   protected:
    std::vector<zJSON*> value;
@@ -736,6 +1372,44 @@ mutable zJSON::zjson_base* m_value;
 
 };
 
+template <class T, class V> void zJSON::visit_tree(T* root, V& visitor)
+{
+ enum { __local_frames__=32 };
+ zjson_visit_frame<T> local[__local_frames__];
+ std::vector<zjson_visit_frame<T> > more;
+ size_t depth=0, n;
+ T* p=root;
+ T* const* c=NULL;
+ for(;;)
+ {
+  n=0;
+  if(visitor.enter(*p, depth)) c=p->m_value->children(n);
+  if(n)
+  {
+   if(depth >= __local_frames__ && (depth-__local_frames__) >= more.size()) more.push_back(zjson_visit_frame<T>());
+   zjson_visit_frame<T>& f=(depth < __local_frames__)?(local[depth]):(more[depth-__local_frames__]);
+   f.p=p;
+   f.pos=c;
+   f.end=c+n;
+   ++depth;
+   p=*c;
+   continue;
+  }
+  visitor.leave(*p, depth);
+  for(;;)
+  {
+   if(depth == 0) return;
+   zjson_visit_frame<T>& f=(depth <= __local_frames__)?(local[depth-1]):(more[depth-1-__local_frames__]);
+   if(++f.pos != f.end) { p=*f.pos; break; }
+   --depth;
+   visitor.leave(*f.p, depth);
+  }
+ }
+};
+
+template <class V> void zJSON::visit(V& visitor) { visit_tree(this, visitor); };
+template <class V> void zJSON::visit(V& visitor) const { visit_tree(this, visitor); };
+
 #endif //__zJSON_h
 
 
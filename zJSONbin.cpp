@@ -0,0 +1,493 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits>
+
+#include "zJSON.h"
+
+extern bool zjson_exact_integer(const zJSON& src, bool& negative, uint64_t& magnitude);
+
+/*
+Binary codecs: CBOR (RFC 7049) and MessagePack.
+*/
+
+static const size_t __bin_max_depth__ = 1024;
+
+static void put_be(std::string& ret, uint64_t n, size_t bytes)
+{
+ for(size_t i=bytes; i > 0; i--) { ret+=(char) ((n >> ((i-1)*8)) & 0xFF); }
+};
+
+static uint64_t get_be(const unsigned char* p, size_t bytes)
+{
+ uint64_t ret=0;
+ for(size_t i=0; i < bytes; i++) { ret <<= 8; ret|=p[i]; }
+ return ret;
+};
+
+static uint64_t double_to_bits(double d)
+{
+ uint64_t ret;
+ memcpy(&ret, &d, sizeof(ret));
+ return ret;
+};
+
+static double bits_to_double(uint64_t n)
+{
+ double ret;
+ memcpy(&ret, &n, sizeof(ret));
+ return ret;
+};
+
+static double bits_to_float(uint32_t n)
+{
+ float ret;
+ memcpy(&ret, &n, sizeof(ret));
+ return ret;
+};
+
+static double half_to_double(unsigned n)
+{
+ int e=(n >> 10) & 0x1F;
+ double m=n & 0x3FF;
+ double ret;
+ if(e == 0) ret=m/16777216.0;
+ else if(e == 31) ret=(m == 0)?(std::numeric_limits<double>::infinity()):(std::numeric_limits<double>::quiet_NaN());
+ else { ret=(m+1024.0); for(; e > 25; e--) ret*=2.; for(; e < 25; e++) ret/=2.; }
+ return (n & 0x8000)?(-ret):(ret);
+};
+
+/*
+CBOR
+*/
+
+static void cbor_head(std::string& ret, unsigned char major, uint64_t n)
+{
+ major <<= 5;
+ if(n < 24) { ret+=(char) (major | n); return; }
+ if(n <= 0xFF) { ret+=(char) (major | 24); put_be(ret, n, 1); return; }
+ if(n <= 0xFFFF) { ret+=(char) (major | 25); put_be(ret, n, 2); return; }
+ if(n <= 0xFFFFFFFFULL) { ret+=(char) (major | 26); put_be(ret, n, 4); return; }
+ ret+=(char) (major | 27); put_be(ret, n, 8);
+};
+
+static void cbor_name(std::string& ret, const std::string& s)
+{
+ cbor_head(ret, 3, s.size());
+ ret.append(s);
+};
+
+static void cbor_value(std::string& ret, const zJSON* p)
+{
+ switch(p->type())
+ {
+  case zJSON::JSON_NULL: { ret+='\xF6'; return; }
+  case zJSON::JSON_BOOLEAN: { ret+=(*p->ptr_boolean())?('\xF5'):('\xF4'); return; }
+  case zJSON::JSON_INTEGER:
+  {
+   bool negative;
+   uint64_t n;
+   if(!zjson_exact_integer(*p, negative, n)) { ret+='\xFB'; put_be(ret, double_to_bits(strtod(p->ptr_raw()->c_str(), NULL)), 8); return; }
+   if(negative) cbor_head(ret, 1, n-1);
+   else cbor_head(ret, 0, n);
+   return;
+  }
+  case zJSON::JSON_NUMBER: { ret+='\xFB'; put_be(ret, double_to_bits(*p->ptr_number()), 8); return; }
+  case zJSON::JSON_STRING: { cbor_name(ret, *p->ptr_string()); return; }
+  case zJSON::JSON_ARRAY: { cbor_head(ret, 4, p->size()); return; }
+  case zJSON::JSON_NODE: { cbor_head(ret, 5, p->size()); return; }
+ }
+};
+
+static bool cbor_arg(uint64_t& ret, const unsigned char* p, size_t len, size_t& pos, unsigned info)
+{
+ size_t n;
+ switch(info)
+ {
+  case 24: { n=1; break; }
+  case 25: { n=2; break; }
+  case 26: { n=4; break; }
+  case 27: { n=8; break; }
+  default: { if(info > 27) return false; ret=info; return true; }
+ }
+ if((len-pos) < n) return false;
+ ret=get_be(p+pos, n);
+ pos+=n;
+ return true;
+};
+
+static bool cbor_string(std::string& ret, const unsigned char* p, size_t len, size_t& pos, unsigned major, unsigned info)
+{
+ uint64_t n;
+ if(info != 31)
+ {
+  if(!cbor_arg(n, p, len, pos, info) || n > (len-pos)) return false;
+  ret.append((const char*) p+pos, (size_t) n);
+  pos+=(size_t) n;
+  return true;
+ }
+ while(pos < len)
+ {
+  if(p[pos] == 0xFF) { ++pos; return true; }
+  if((p[pos] >> 5) != major || (p[pos] & 0x1F) == 31) return false;
+  info=p[pos] & 0x1F;
+  ++pos;
+  if(!cbor_arg(n, p, len, pos, info) || n > (len-pos)) return false;
+  ret.append((const char*) p+pos, (size_t) n);
+  pos+=(size_t) n;
+ }
+ return false;
+};
+
+static zJSON* cbor_read(const unsigned char* p, size_t len, size_t& pos, const std::string& json_name, size_t depth);
+
+/*
+cbor_negative returns the text of the negative integer -1-n (n+1 may not fit uint64_t).
+*/
+static std::string cbor_negative(uint64_t n)
+{
+ std::string ret=zJSON::toString(n);
+ size_t i=ret.size();
+ for(; i > 0 && ret[i-1] == '9'; i--) ret[i-1]='0';
+ if(i == 0) ret.insert(0, 1, '1');
+ else ++ret[i-1];
+ return '-'+ret;
+};
+
+static bool cbor_key(std::string& ret, const unsigned char* p, size_t len, size_t& pos)
+{
+ if(pos >= len) return false;
+ unsigned major=p[pos] >> 5;
+ unsigned info=p[pos] & 0x1F;
+ uint64_t n;
+ ++pos;
+ switch(major)
+ {
+  case 0: { if(!cbor_arg(n, p, len, pos, info)) return false; ret=zJSON::toString(n); return true; }
+  case 1: { if(!cbor_arg(n, p, len, pos, info)) return false; ret=cbor_negative(n); return true; }
+  case 2:
+  case 3: { ret.clear(); return cbor_string(ret, p, len, pos, major, info); }
+ }
+ return false;
+};
+
+static zJSON* cbor_read(const unsigned char* p, size_t len, size_t& pos, const std::string& json_name, size_t depth)
+{
+ if(pos >= len || depth > __bin_max_depth__) return NULL;
+ unsigned major=p[pos] >> 5;
+ unsigned info=p[pos] & 0x1F;
+ uint64_t n=0;
+ ++pos;
+ if(info == 31 && (major < 2 || major == 6)) return NULL;
+ if(info != 31 && major != 7 && !cbor_arg(n, p, len, pos, info)) return NULL;
+ switch(major)
+ {
+  case 0: { return new zJSON(json_name, n); }
+  case 1:
+  {
+   if(n > 0x7FFFFFFFFFFFFFFFULL)
+   {
+    zJSON::zOptionJSON opt;
+    opt.raw_numbers=true;
+    size_t res_pos;
+    zJSON* ret=zJSON::parse<zJSON::Strict>(cbor_negative(n), 0, res_pos, opt);
+    if(ret) ret->name()=json_name;
+    return ret;
+   }
+   return new zJSON(json_name, (int64_t) (-1-(int64_t) n));
+  }
+  case 2:
+  case 3:
+  {
+   std::string s;
+   if(info != 31) { if(n > (len-pos)) return NULL; s.assign((const char*) p+pos, (size_t) n); pos+=(size_t) n; }
+   else if(!cbor_string(s, p, len, pos, major, info)) return NULL;
+   return new zJSON(json_name, s);
+  }
+  case 4:
+  case 5:
+  {
+   zJSON* ret= new zJSON((major == 4)?(zJSON::JSON_ARRAY):(zJSON::JSON_NODE), json_name);
+   std::string s;
+   zJSON* p_json;
+   if(info != 31) ret->reserve((n < (len-pos))?((size_t) n):(len-pos));
+   for(uint64_t i=0; info == 31 || i < n; i++)
+   {
+    if(info == 31 && pos < len && p[pos] == 0xFF) { ++pos; return ret; }
+    if(major == 5 && !cbor_key(s, p, len, pos)) { delete ret; return NULL; }
+    p_json=cbor_read(p, len, pos, s, depth+1);
+    if(p_json == NULL) { delete ret; return NULL; }
+    ret->push_back(p_json);
+   }
+   return ret;
+  }
+  case 6: { return cbor_read(p, len, pos, json_name, depth+1); }
+ }
+ switch(info)
+ {
+  case 20: { return new zJSON(json_name, false); }
+  case 21: { return new zJSON(json_name, true); }
+  case 22:
+  case 23: { return new zJSON(zJSON::JSON_NULL, json_name); }
+  case 24: { if(pos >= len) return NULL; ++pos; return new zJSON(zJSON::JSON_NULL, json_name); }
+  case 25: { if((len-pos) < 2) return NULL; pos+=2; return new zJSON(json_name, half_to_double((unsigned) get_be(p+pos-2, 2))); }
+  case 26: { if((len-pos) < 4) return NULL; pos+=4; return new zJSON(json_name, bits_to_float((uint32_t) get_be(p+pos-4, 4))); }
+  case 27: { if((len-pos) < 8) return NULL; pos+=8; return new zJSON(json_name, bits_to_double(get_be(p+pos-8, 8))); }
+ }
+ if(info < 20) return new zJSON(zJSON::JSON_NULL, json_name);
+ return NULL;
+};
+
+/*
+MessagePack
+*/
+
+static void msgpack_string(std::string& ret, const std::string& s)
+{
+ size_t n=s.size();
+ if(n < 32) ret+=(char) (0xA0 | n);
+ else if(n <= 0xFF) { ret+='\xD9'; put_be(ret, n, 1); }
+ else if(n <= 0xFFFF) { ret+='\xDA'; put_be(ret, n, 2); }
+ else { ret+='\xDB'; put_be(ret, n, 4); }
+ ret.append(s);
+};
+
+static void msgpack_container(std::string& ret, unsigned char fix, char c16, char c32, size_t n)
+{
+ if(n < 16) ret+=(char) (fix | n);
+ else if(n <= 0xFFFF) { ret+=c16; put_be(ret, n, 2); }
+ else { ret+=c32; put_be(ret, n, 4); }
+};
+
+static void msgpack_value(std::string& ret, const zJSON* p)
+{
+ switch(p->type())
+ {
+  case zJSON::JSON_NULL: { ret+='\xC0'; return; }
+  case zJSON::JSON_BOOLEAN: { ret+=(*p->ptr_boolean())?('\xC3'):('\xC2'); return; }
+  case zJSON::JSON_INTEGER:
+  {
+   bool negative;
+   uint64_t u;
+   if(!zjson_exact_integer(*p, negative, u) || (negative && u > ((uint64_t) INT64_MAX)+1))
+   {
+    ret+='\xCB'; put_be(ret, double_to_bits(strtod(p->ptr_raw()->c_str(), NULL)), 8);
+    return;
+   }
+   if(!negative)
+   {
+    if(u < 128) ret+=(char) u;
+    else if(u <= 0xFF) { ret+='\xCC'; put_be(ret, u, 1); }
+    else if(u <= 0xFFFF) { ret+='\xCD'; put_be(ret, u, 2); }
+    else if(u <= 0xFFFFFFFFULL) { ret+='\xCE'; put_be(ret, u, 4); }
+    else { ret+='\xCF'; put_be(ret, u, 8); }
+    return;
+   }
+   int64_t n=(int64_t) (0-u);
+   if(n >= -32) ret+=(char) n;
+   else if(n >= -128) { ret+='\xD0'; put_be(ret, (uint64_t) n, 1); }
+   else if(n >= -32768) { ret+='\xD1'; put_be(ret, (uint64_t) n, 2); }
+   else if(n >= -2147483648LL) { ret+='\xD2'; put_be(ret, (uint64_t) n, 4); }
+   else { ret+='\xD3'; put_be(ret, (uint64_t) n, 8); }
+   return;
+  }
+  case zJSON::JSON_NUMBER: { ret+='\xCB'; put_be(ret, double_to_bits(*p->ptr_number()), 8); return; }
+  case zJSON::JSON_STRING: { msgpack_string(ret, *p->ptr_string()); return; }
+  case zJSON::JSON_ARRAY: { msgpack_container(ret, 0x90, '\xDC', '\xDD', p->size()); return; }
+  case zJSON::JSON_NODE: { msgpack_container(ret, 0x80, '\xDE', '\xDF', p->size()); return; }
+ }
+};
+
+static zJSON* msgpack_read(const unsigned char* p, size_t len, size_t& pos, const std::string& json_name, size_t depth);
+
+static bool msgpack_key(std::string& ret, const unsigned char* p, size_t len, size_t& pos, size_t depth)
+{
+ if(pos >= len) return false;
+ unsigned char c=p[pos];
+ if((c >= 0x80 && c <= 0x9F) || (c >= 0xDC && c <= 0xDF)) return false;
+ size_t n;
+ if(c >= 0xA0 && c <= 0xBF) { n=c & 0x1F; ++pos; }
+ else if(c == 0xD9 || c == 0xC4) { if((len-pos) < 2) return false; n=p[pos+1]; pos+=2; }
+ else if(c == 0xDA || c == 0xC5) { if((len-pos) < 3) return false; n=(size_t) get_be(p+pos+1, 2); pos+=3; }
+ else if(c == 0xDB || c == 0xC6) { if((len-pos) < 5) return false; n=(size_t) get_be(p+pos+1, 4); pos+=5; }
+ else
+ {
+  zJSON* p_json=msgpack_read(p, len, pos, "", depth+1);
+  if(p_json == NULL) return false;
+  bool b=(p_json->type() == zJSON::JSON_INTEGER);
+  if(b) ret=p_json->as_string();
+  delete p_json;
+  return b;
+ }
+ if(n > (len-pos)) return false;
+ ret.assign((const char*) p+pos, n);
+ pos+=n;
+ return true;
+};
+
+static zJSON* msgpack_read(const unsigned char* p, size_t len, size_t& pos, const std::string& json_name, size_t depth)
+{
+ if(pos >= len || depth > __bin_max_depth__) return NULL;
+ unsigned char c=p[pos];
+ size_t n=0;
+ int type=zJSON::JSON_NULL;
+ ++pos;
+ if(c <= 0x7F) return new zJSON(json_name, (int64_t) c);
+ if(c >= 0xE0) return new zJSON(json_name, (int64_t) (signed char) c);
+ if(c <= 0x8F) { type=zJSON::JSON_NODE; n=c & 0x0F; }
+ else if(c <= 0x9F) { type=zJSON::JSON_ARRAY; n=c & 0x0F; }
+ else if(c <= 0xBF) { type=zJSON::JSON_STRING; n=c & 0x1F; }
+ else
+ {
+  static const unsigned char __size__[32]=
+  { 0, 0, 0, 0, 1, 2, 4, 0, 0, 0, 4, 8, 1, 2, 4, 8, 1, 2, 4, 8, 0, 0, 0, 0, 0, 1, 2, 4, 2, 4, 2, 4 };
+  size_t l=__size__[c-0xC0];
+  if((len-pos) < l) return NULL;
+  uint64_t v=get_be(p+pos, l);
+  pos+=l;
+  switch(c)
+  {
+   case 0xC0: { return new zJSON(zJSON::JSON_NULL, json_name); }
+   case 0xC2: { return new zJSON(json_name, false); }
+   case 0xC3: { return new zJSON(json_name, true); }
+   case 0xCA: { return new zJSON(json_name, bits_to_float((uint32_t) v)); }
+   case 0xCB: { return new zJSON(json_name, bits_to_double(v)); }
+   case 0xCC:
+   case 0xCD:
+   case 0xCE:
+   case 0xCF: { return new zJSON(json_name, v); }
+   case 0xD0: { return new zJSON(json_name, (int64_t) (int8_t) v); }
+   case 0xD1: { return new zJSON(json_name, (int64_t) (int16_t) v); }
+   case 0xD2: { return new zJSON(json_name, (int64_t) (int32_t) v); }
+   case 0xD3: { return new zJSON(json_name, (int64_t) v); }
+   case 0xC4:
+   case 0xC5:
+   case 0xC6:
+   case 0xD9:
+   case 0xDA:
+   case 0xDB: { type=zJSON::JSON_STRING; n=(size_t) v; break; }
+   case 0xDC:
+   case 0xDD: { type=zJSON::JSON_ARRAY; n=(size_t) v; break; }
+   case 0xDE:
+   case 0xDF: { type=zJSON::JSON_NODE; n=(size_t) v; break; }
+   default: { return NULL; }
+  }
+ }
+ if(type == zJSON::JSON_STRING)
+ {
+  if(n > (len-pos)) return NULL;
+  pos+=n;
+  return new zJSON(json_name, std::string((const char*) p+pos-n, n));
+ }
+ zJSON* ret= new zJSON(type, json_name);
+ std::string s;
+ zJSON* p_json;
+ ret->reserve((n < (len-pos))?(n):(len-pos));
+ for(size_t i=0; i < n; i++)
+ {
+  if(type == zJSON::JSON_NODE && !msgpack_key(s, p, len, pos, depth)) { delete ret; return NULL; }
+  p_json=msgpack_read(p, len, pos, s, depth+1);
+  if(p_json == NULL) { delete ret; return NULL; }
+  ret->push_back(p_json);
+ }
+ return ret;
+};
+
+struct zjson_bin_frame
+{
+ const zJSON* p;
+ size_t pos;
+};
+
+struct zjson_cbor_format
+{
+ static void value(std::string& ret, const zJSON* p) { cbor_value(ret, p); };
+ static void name(std::string& ret, const std::string& s) { cbor_name(ret, s); };
+};
+
+struct zjson_msgpack_format
+{
+ static void value(std::string& ret, const zJSON* p) { msgpack_value(ret, p); };
+ static void name(std::string& ret, const std::string& s) { msgpack_string(ret, s); };
+};
+
+/*
+bin_write walks the tree with the explicit stack (any nesting which the tree holds is written): F::value writes the plain
+value or the head of the container with the number of its children, F::name writes the name before every child of
+JSON_NODE.
+*/
+template <class F> static void bin_write(std::string& ret, const zJSON* root)
+{
+ std::vector<zjson_bin_frame> stack;
+ zjson_bin_frame f;
+ const zJSON* p=root;
+ for(;;)
+ {
+  F::value(ret, p);
+  if((p->type() == zJSON::JSON_ARRAY || p->type() == zJSON::JSON_NODE) && p->size())
+  {
+   f.p=p;
+   f.pos=0;
+   stack.push_back(f);
+  }
+  for(;;)
+  {
+   if(stack.empty()) return;
+   zjson_bin_frame& top=stack.back();
+   if(top.pos < top.p->size())
+   {
+    p=top.p->at(top.pos++);
+    if(top.p->type() == zJSON::JSON_NODE) F::name(ret, p->name());
+    break;
+   }
+   stack.pop_back();
+  }
+ }
+};
+
+void zJSON::write_cbor(std::string& ret) const { bin_write<zjson_cbor_format>(ret, this); };
+
+void zJSON::write_msgpack(std::string& ret) const { bin_write<zjson_msgpack_format>(ret, this); };
+
+zJSON* zJSON::parse_cbor(const char* src, size_t len, size_t pos)
+{
+ if(pos >= len) return NULL;
+ return cbor_read((const unsigned char*) src, len, pos, "", 0);
+};
+
+zJSON* zJSON::parse_cbor(const char* src, size_t len, size_t pos, size_t& res_pos)
+{
+ res_pos=pos;
+ if(pos >= len) return NULL;
+ return cbor_read((const unsigned char*) src, len, res_pos, "", 0);
+};
+
+zJSON* zJSON::parse_msgpack(const char* src, size_t len, size_t pos)
+{
+ if(pos >= len) return NULL;
+ return msgpack_read((const unsigned char*) src, len, pos, "", 0);
+};
+
+zJSON* zJSON::parse_msgpack(const char* src, size_t len, size_t pos, size_t& res_pos)
+{
+ res_pos=pos;
+ if(pos >= len) return NULL;
+ return msgpack_read((const unsigned char*) src, len, res_pos, "", 0);
+};
@@ -0,0 +1,491 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __zJSONbind_h
+#define __zJSONbind_h 1
+
+#include <string.h>
+#include <limits>
+#include <map>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+
+#include "zJSON.h"
+
+/*
+zJSONbind reads JSON text directly into C++ structs, std::vector, std::map and plain types and writes them back to JSON text
+without creating of zJSON objects. The struct is bound by the list of its members declared in the global namespace:
+
+struct Point { int x; int y; std::string label; };
+
+ZJSON_BIND_BEGIN(Point)
+ ZJSON_BIND_FIELD(x)
+ ZJSON_BIND_FIELD(y)
+ ZJSON_BIND_NAMED(label, "name")
+ZJSON_BIND_END()
+
+Point pt;
+zJSONbind::parse(pt, "{ \"x\" : 1, \"y\" : 2, \"name\" : \"A\" }");
+std::string s=zJSONbind::write(pt); // {"x":1,"y":2,"name":"A"}
+
+The text is read the same way as zJSON::parse does it (comments, trailing commas, concatenation of adjacent strings).
+The keys are compared with the member names of fixed length, unknown keys are skipped, the members which are absent in
+the text or have null value are not changed.
+*/
+
+template <class T> class zjson_fields;
+
+#define ZJSON_BIND_BEGIN(T) \
+template <> class zjson_fields<T> \
+{ \
+public: \
+ template <class V, class F> static bool fields(V& v, F& f) \
+ { \
+  return true
+#define ZJSON_BIND_FIELD(m) && f(#m, "\"" #m "\":", v.m)
+#define ZJSON_BIND_NAMED(m, json_name) && f(json_name, zjson_bind_name(), v.m)
+#define ZJSON_BIND_END() ; } };
+
+struct zjson_bind_name {};
+/*
+zjson_bind_name marks the member bound by ZJSON_BIND_NAMED: its name may contain characters which need escaping, so the key
+is escaped when it is written instead of the key text made by the macro.
+*/
+
+static const size_t __bind_max_depth__ = 1024;
+
+template <class T> class zjson_value
+{
+public:
+ static bool read(T& ret, const char* p, size_t len, size_t& pos, size_t level);
+ static void write(std::string& ret, const T& value);
+};
+
+template <class T> class zjson_key_reader
+{
+public:
+ zjson_key_reader(const std::string& key, const char* p, size_t len, size_t& pos, size_t level):
+  m_key(key), m_p(p), m_len(len), m_pos(pos), m_level(level), matched(false), error(false) {};
+
+ template <size_t N, class K, class M> bool operator()(const char (&json_name)[N], const K&, M& m)
+ {
+  if((N-1) != m_key.size() || memcmp(json_name, m_key.data(), N-1) != 0) return true;
+  matched=true;
+  if(!zjson_value<M>::read(m, m_p, m_len, m_pos, m_level)) error=true;
+  return false;
+ };
+
+ const std::string& m_key;
+ const char* m_p;
+ size_t m_len;
+ size_t& m_pos;
+ size_t m_level;
+ bool matched;
+ bool error;
+};
+
+class zjson_key_writer
+{
+public:
+ zjson_key_writer(std::string& ret): m_ret(ret), m_first(true) {};
+
+ template <size_t N, size_t K, class M> bool operator()(const char (&)[N], const char (&json_key)[K], const M& m)
+ {
+  if(!m_first) m_ret+=',';
+  m_first=false;
+  m_ret.append(json_key, K-1);
+  zjson_value<M>::write(m_ret, m);
+  return true;
+ };
+#if __cplusplus >= 201703L
+ template <size_t N, size_t K, class M> bool operator()(const char (&json_name)[N], const char (&json_key)[K], const std::optional<M>& m)
+ {
+  if(!m) return true;
+  return (*this)(json_name, json_key, *m);
+ };
+#endif
+ template <size_t N, class M> bool operator()(const char (&json_name)[N], zjson_bind_name, const M& m)
+ {
+  if(!m_first) m_ret+=',';
+  m_first=false;
+  m_ret+='"';
+  zJSON::escape(m_ret, json_name, N-1);
+  m_ret.append("\":", 2);
+  zjson_value<M>::write(m_ret, m);
+  return true;
+ };
+#if __cplusplus >= 201703L
+ template <size_t N, class M> bool operator()(const char (&json_name)[N], zjson_bind_name, const std::optional<M>& m)
+ {
+  if(!m) return true;
+  return (*this)(json_name, zjson_bind_name(), *m);
+ };
+#endif
+
+ std::string& m_ret;
+ bool m_first;
+};
+
+static inline bool zjson_bind_null(const char* p, size_t len, size_t& pos)
+{
+ bool b;
+ size_t l=pos;
+ if(zJSON::scan_literal(b, p, len, l) != zJSON::JSON_NULL) return false;
+ pos=l;
+ return true;
+};
+
+static inline bool zjson_bind_unsigned(const char* p, size_t len, uint64_t& ret)
+{
+ size_t i=0;
+ ret=0;
+ for(; i < len && (p[i] < '0' || p[i] > '9'); ++i);
+ for(; i < len && p[i] >= '0' && p[i] <= '9'; ++i)
+ {
+  unsigned d=((unsigned char) p[i] - '0');
+  if(ret > (UINT64_MAX-d)/10) return false;
+  ret=ret*10+d;
+ }
+ return true;
+};
+
+static inline bool zjson_bind_open(char c, const char* p, size_t len, size_t& pos, size_t level)
+{
+ if(level >= __bind_max_depth__ || !zJSON::scan_blank(p, len, pos) || p[pos] != c) return false;
+ ++pos;
+ return true;
+};
+
+static inline bool zjson_bind_next(const char* p, size_t len, size_t& pos)
+{
+ if(!zJSON::scan_blank(p, len, pos)) return false;
+ if(p[pos] == ',') { ++pos; if(!zJSON::scan_blank(p, len, pos)) return false; }
+ return true;
+};
+
+template <class T> bool zjson_value<T>::read(T& ret, const char* p, size_t len, size_t& pos, size_t level)
+{
+ if(zjson_bind_null(p, len, pos)) return true;
+ size_t l=pos;
+ if(!zjson_bind_open('{', p, len, l, level)) return false;
+ if(!zJSON::scan_blank(p, len, l)) return false;
+ std::string key;
+ while(p[l] != '}')
+ {
+  if(!zJSON::scan_name(key, p, len, l)) return false;
+  zjson_key_reader<T> f(key, p, len, l, level+1);
+  zjson_fields<T>::fields(ret, f);
+  if(f.error) return false;
+  if(!f.matched && !zJSON::skip(p, len, l)) return false;
+  if(!zjson_bind_next(p, len, l)) return false;
+ }
+ pos=l+1;
+ return true;
+};
+
+template <class T> void zjson_value<T>::write(std::string& ret, const T& value)
+{
+ ret+='{';
+ zjson_key_writer f(ret);
+ zjson_fields<T>::fields(value, f);
+ ret+='}';
+};
+
+template <> inline bool zjson_value<bool>::read(bool& ret, const char* p, size_t len, size_t& pos, size_t)
+{
+ bool b;
+ switch(zJSON::scan_literal(b, p, len, pos))
+ {
+  case zJSON::JSON_NULL: { return true; }
+  case zJSON::JSON_BOOLEAN: { ret=b; return true; }
+ }
+ return false;
+};
+
+template <> inline void zjson_value<bool>::write(std::string& ret, const bool& value)
+{ if(value) ret.append("true", 4); else ret.append("false", 5); };
+
+#define ZJSON_BIND_INTEGER(T) \
+template <> inline bool zjson_value<T>::read(T& ret, const char* p, size_t len, size_t& pos, size_t) \
+{ \
+ if(zjson_bind_null(p, len, pos)) return true; \
+ int64_t integer; \
+ double number; \
+ size_t l=pos; \
+ int kind=zJSON::scan_number(integer, number, p, len, l); \
+ switch(kind) \
+ { \
+  case zJSON::JSON_INTEGER: { break; } \
+  case zJSON::JSON_NUMBER: \
+  { \
+   if(number < -9223372036854775808.0 || number >= 9223372036854775808.0) return false; \
+   break; \
+  } \
+  default: { return false; } \
+ } \
+ if(std::numeric_limits<T>::is_signed) \
+ { \
+  if(integer < (int64_t) std::numeric_limits<T>::min() || integer > (int64_t) std::numeric_limits<T>::max()) return false; \
+  if((integer == INT64_MAX || integer == INT64_MIN) && kind == zJSON::JSON_INTEGER) \
+  { \
+   uint64_t exact; \
+   if(!zjson_bind_unsigned(p+pos, l-pos, exact) || exact > ((uint64_t) INT64_MAX)+((integer < 0)?(1):(0))) return false; \
+  } \
+ } \
+ else \
+ { \
+  uint64_t exact=(uint64_t) integer; \
+  if(integer < 0) return false; \
+  if(integer == INT64_MAX && kind == zJSON::JSON_INTEGER && !zjson_bind_unsigned(p+pos, l-pos, exact)) return false; \
+  if(exact > (uint64_t) std::numeric_limits<T>::max()) return false; \
+  integer=(int64_t) exact; \
+ } \
+ ret=(T) integer; \
+ pos=l; \
+ return true; \
+}; \
+template <> inline void zjson_value<T>::write(std::string& ret, const T& value) \
+{ \
+ if(std::numeric_limits<T>::is_signed) ret+=zJSON::toString((int64_t) value); \
+ else ret+=zJSON::toString((uint64_t) value); \
+};
+
+ZJSON_BIND_INTEGER(char)
+ZJSON_BIND_INTEGER(signed char)
+ZJSON_BIND_INTEGER(unsigned char)
+ZJSON_BIND_INTEGER(short)
+ZJSON_BIND_INTEGER(unsigned short)
+ZJSON_BIND_INTEGER(int)
+ZJSON_BIND_INTEGER(unsigned)
+ZJSON_BIND_INTEGER(long)
+ZJSON_BIND_INTEGER(unsigned long)
+ZJSON_BIND_INTEGER(long long)
+ZJSON_BIND_INTEGER(unsigned long long)
+
+#undef ZJSON_BIND_INTEGER
+
+#define ZJSON_BIND_NUMBER(T) \
+template <> inline bool zjson_value<T>::read(T& ret, const char* p, size_t len, size_t& pos, size_t) \
+{ \
+ if(zjson_bind_null(p, len, pos)) return true; \
+ int64_t integer; \
+ double number; \
+ if(zJSON::scan_number(integer, number, p, len, pos) < 0) return false; \
+ ret=(T) number; \
+ return true; \
+}; \
+template <> inline void zjson_value<T>::write(std::string& ret, const T& value) \
+{ ret+=zJSON::toString((double) value); };
+
+ZJSON_BIND_NUMBER(float)
+ZJSON_BIND_NUMBER(double)
+ZJSON_BIND_NUMBER(long double)
+
+#undef ZJSON_BIND_NUMBER
+
+template <> inline bool zjson_value<std::string>::read(std::string& ret, const char* p, size_t len, size_t& pos, size_t)
+{
+ if(zjson_bind_null(p, len, pos)) return true;
+ return zJSON::scan_string(ret, p, len, pos);
+};
+
+template <> inline void zjson_value<std::string>::write(std::string& ret, const std::string& value)
+{
+ ret+='\"';
+ zJSON::escape(ret, value.c_str(), value.size());
+ ret+='\"';
+};
+
+template <> inline bool zjson_value<zJSON>::read(zJSON& ret, const char* p, size_t len, size_t& pos, size_t)
+{
+ size_t l;
+ if(!zJSON::parse(ret, p, len, pos, l)) return false;
+ pos=l;
+ return true;
+};
+
+template <> inline void zjson_value<zJSON>::write(std::string& ret, const zJSON& value)
+{
+ if(value.name().empty()) { value.write(ret); return; }
+ zJSON v(value);
+ v.name().clear();
+ v.write(ret);
+};
+
+template <class T> class zjson_value< std::vector<T> >
+{
+public:
+ static bool read(std::vector<T>& ret, const char* p, size_t len, size_t& pos, size_t level)
+ {
+  if(zjson_bind_null(p, len, pos)) return true;
+  size_t l=pos;
+  if(!zjson_bind_open('[', p, len, l, level)) return false;
+  if(!zJSON::scan_blank(p, len, l)) return false;
+  std::vector<T> v;
+  while(p[l] != ']')
+  {
+   v.push_back(T());
+   if(!zjson_value<T>::read(v.back(), p, len, l, level+1)) return false;
+   if(!zjson_bind_next(p, len, l)) return false;
+  }
+  ret.swap(v);
+  pos=l+1;
+  return true;
+ };
+
+ static void write(std::string& ret, const std::vector<T>& value)
+ {
+  ret+='[';
+  for(size_t i=0; i < value.size(); ++i)
+  {
+   if(i) ret+=',';
+   zjson_value<T>::write(ret, value[i]);
+  }
+  ret+=']';
+ };
+};
+
+template <> class zjson_value< std::vector<bool> >
+{
+public:
+ static bool read(std::vector<bool>& ret, const char* p, size_t len, size_t& pos, size_t level)
+ {
+  if(zjson_bind_null(p, len, pos)) return true;
+  size_t l=pos;
+  if(!zjson_bind_open('[', p, len, l, level)) return false;
+  if(!zJSON::scan_blank(p, len, l)) return false;
+  std::vector<bool> v;
+  while(p[l] != ']')
+  {
+   bool b=false;
+   if(!zjson_value<bool>::read(b, p, len, l, level+1)) return false;
+   v.push_back(b);
+   if(!zjson_bind_next(p, len, l)) return false;
+  }
+  ret.swap(v);
+  pos=l+1;
+  return true;
+ };
+
+ static void write(std::string& ret, const std::vector<bool>& value)
+ {
+  ret+='[';
+  for(size_t i=0; i < value.size(); ++i)
+  {
+   if(i) ret+=',';
+   zjson_value<bool>::write(ret, value[i]);
+  }
+  ret+=']';
+ };
+};
+
+template <class T> class zjson_value< std::map<std::string, T> >
+{
+public:
+ static bool read(std::map<std::string, T>& ret, const char* p, size_t len, size_t& pos, size_t level)
+ {
+  if(zjson_bind_null(p, len, pos)) return true;
+  size_t l=pos;
+  if(!zjson_bind_open('{', p, len, l, level)) return false;
+  if(!zJSON::scan_blank(p, len, l)) return false;
+  std::map<std::string, T> v;
+  std::string key;
+  while(p[l] != '}')
+  {
+   if(!zJSON::scan_name(key, p, len, l)) return false;
+   if(!zjson_value<T>::read(v[key], p, len, l, level+1)) return false;
+   if(!zjson_bind_next(p, len, l)) return false;
+  }
+  ret.swap(v);
+  pos=l+1;
+  return true;
+ };
+
+ static void write(std::string& ret, const std::map<std::string, T>& value)
+ {
+  ret+='{';
+  for(typename std::map<std::string, T>::const_iterator it=value.begin(); it != value.end(); ++it)
+  {
+   if(it != value.begin()) ret+=',';
+   zjson_value<std::string>::write(ret, it->first);
+   ret+=':';
+   zjson_value<T>::write(ret, it->second);
+  }
+  ret+='}';
+ };
+};
+
+#if __cplusplus >= 201703L
+template <class T> class zjson_value< std::optional<T> >
+{
+public:
+ static bool read(std::optional<T>& ret, const char* p, size_t len, size_t& pos, size_t level)
+ {
+  if(zjson_bind_null(p, len, pos)) { ret.reset(); return true; }
+  T v=T();
+  if(!zjson_value<T>::read(v, p, len, pos, level)) return false;
+  ret=v;
+  return true;
+ };
+
+ static void write(std::string& ret, const std::optional<T>& value)
+ {
+  if(!value) { ret.append("null", 4); return; }
+  zjson_value<T>::write(ret, *value);
+ };
+};
+#endif
+
+class zJSONbind
+{
+public:
+
+template <class T> static bool parse(T& ret, const char* src, size_t len, size_t start_pos=0)
+{ size_t res_pos; return parse(ret, src, len, start_pos, res_pos); };
+template <class T> static bool parse(T& ret, const std::string& src, size_t start_pos=0)
+{ size_t res_pos; return parse(ret, src.c_str(), src.size(), start_pos, res_pos); };
+template <class T> static bool parse(T& ret, const std::string& src, size_t start_pos, size_t& res_pos)
+{ return parse(ret, src.c_str(), src.size(), start_pos, res_pos); };
+template <class T> static bool parse(T& ret, const char* src, size_t len, size_t start_pos, size_t& res_pos)
+{
+ res_pos=start_pos;
+ if(start_pos >= len) return false;
+ size_t l=start_pos;
+ if(!zjson_value<T>::read(ret, src, len, l, 0)) return false;
+ res_pos=l;
+ return true;
+};
+/*
+Reads JSON text src start at start_pos into ret. T is bool, integer or floating point type, std::string, zJSON, the struct
+bound by ZJSON_BIND_BEGIN or std::vector, std::map<std::string, ...> and std::optional (C++17) of these types.
+res_pos is set to the position after the value. Returns true if successfully , false if unsuccessfully (ret may be
+partially filled).
+*/
+template <class T> static void write(std::string& ret, const T& value)
+{ zjson_value<T>::write(ret, value); };
+template <class T> static std::string write(const T& value)
+{ std::string ret; zjson_value<T>::write(ret, value); return ret; };
+/*
+Writes value as compact JSON text to ret (appends) or returns it. The members of the bound struct are written in order of
+declaration, empty std::optional members are omitted. The name given by ZJSON_BIND_NAMED is escaped the same way as
+JSON_STRING.
+*/
+};
+
+#endif //__zJSONbind_h
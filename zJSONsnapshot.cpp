@@ -0,0 +1,521 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "zJSONsnapshot.h"
+
+extern bool zjson_exact_integer(const zJSON& src, bool& negative, uint64_t& magnitude);
+
+/*
+Image layout (native byte order):
+ header,
+ node table (zjson_record[nodes], the root is the first record, children follow their parent in depth-first order),
+ child index table (uint32_t[children], children of JSON_ARRAY/JSON_NODE are placed at [value, value+size)),
+ string pool (names are prefixed by uint32_t length, all strings are zero terminated).
+The value of JSON_INTEGER is int64_t, or uint64_t if size is 1 (the integer greater than INT64_MAX, version 2). The integer out
+of both ranges is written as JSON_NUMBER.
+*/
+
+struct zjson_snapshot_header
+{
+ char magic[8];
+ uint32_t order;
+ uint32_t version;
+ uint64_t size;
+ uint64_t nodes;
+ uint64_t nodes_offset;
+ uint64_t children;
+ uint64_t children_offset;
+ uint64_t strings_offset;
+ uint64_t strings_size;
+};
+
+static const char __snapshot_magic__[8] = { 'Z', 'J', 'S', 'N', 'A', 'P', '\0', '\1' };
+static const uint32_t __snapshot_order__ = 0x01020304;
+static const uint32_t __snapshot_version__ = 2;
+static const uint32_t __snapshot_none__ = 0xFFFFFFFF;
+
+struct zjson_snapshot_frame
+{
+ const zJSON* p;
+ uint32_t index;
+ size_t first;
+ size_t pos;
+};
+
+class zjson_snapshot_writer
+{
+ public:
+  zjson_snapshot_writer(): nodes(), children(), strings(), names() { };
+
+  std::vector<zJSONsnapshot::zjson_record> nodes;
+  std::vector<uint32_t> children;
+  std::string strings;
+  std::map<std::string, uint64_t> names;
+
+  uint64_t add_name(const std::string& s);
+  uint64_t add_string(const std::string& s);
+  void add_record(const zJSON* p, uint32_t parent, std::vector<zjson_snapshot_frame>& stack);
+  void add(const zJSON* root);
+  size_t size() const;
+  void write(char* dst) const;
+};
+
+uint64_t zjson_snapshot_writer::add_name(const std::string& s)
+{
+ std::map<std::string, uint64_t>::const_iterator it=names.find(s);
+ if(it != names.end()) return it->second;
+ uint32_t n=(uint32_t) s.size();
+ strings.append((const char*) &n, sizeof(n));
+ uint64_t ret=strings.size();
+ strings.append(s);
+ strings+='\0';
+ names[s]=ret;
+ return ret;
+};
+
+uint64_t zjson_snapshot_writer::add_string(const std::string& s)
+{
+ uint64_t ret=strings.size();
+ strings.append(s);
+ strings+='\0';
+ return ret;
+};
+
+void zjson_snapshot_writer::add_record(const zJSON* p, uint32_t parent, std::vector<zjson_snapshot_frame>& stack)
+{
+ zJSONsnapshot::zjson_record r;
+ r.type=p->type();
+ r.parent=parent;
+ r.name=add_name(p->name());
+ r.value=0;
+ r.size=0;
+ switch(r.type)
+ {
+  case zJSON::JSON_BOOLEAN: { r.value=(*p->ptr_boolean())?(1):(0); break; }
+  case zJSON::JSON_INTEGER:
+  {
+   bool negative;
+   uint64_t n;
+   if(zjson_exact_integer(*p, negative, n) && (!negative || n <= ((uint64_t) INT64_MAX)+1))
+   {
+    r.value=(negative)?(0-n):(n);
+    r.size=(!negative && n > (uint64_t) INT64_MAX)?(1):(0);
+    break;
+   }
+   double d=strtod(p->ptr_raw()->c_str(), NULL);
+   r.type=zJSON::JSON_NUMBER;
+   memcpy(&r.value, &d, sizeof(r.value));
+   break;
+  }
+  case zJSON::JSON_NUMBER: { memcpy(&r.value, p->ptr_number(), sizeof(r.value)); break; }
+  case zJSON::JSON_STRING: { r.value=add_string(*p->ptr_string()); r.size=p->ptr_string()->size(); break; }
+  case zJSON::JSON_ARRAY:
+  case zJSON::JSON_NODE:
+  {
+   zjson_snapshot_frame f;
+   f.p=p;
+   f.index=(uint32_t) nodes.size();
+   f.first=children.size();
+   f.pos=0;
+   r.value=f.first;
+   r.size=p->size();
+   children.resize(f.first+p->size());
+   if(p->size()) stack.push_back(f);
+   break;
+  }
+ }
+ nodes.push_back(r);
+};
+
+void zjson_snapshot_writer::add(const zJSON* root)
+{
+ std::vector<zjson_snapshot_frame> stack;
+ add_record(root, __snapshot_none__, stack);
+ while(!stack.empty())
+ {
+  zjson_snapshot_frame& top=stack.back();
+  if(top.pos == top.p->size()) { stack.pop_back(); continue; }
+  const zJSON* p=top.p->at(top.pos);
+  uint32_t parent=top.index;
+  children[top.first+top.pos]=(uint32_t) nodes.size();
+  ++top.pos;
+  add_record(p, parent, stack);
+ }
+};
+
+size_t zjson_snapshot_writer::size() const
+{
+ return sizeof(zjson_snapshot_header)+nodes.size()*sizeof(zJSONsnapshot::zjson_record)+children.size()*sizeof(uint32_t)+strings.size();
+};
+
+void zjson_snapshot_writer::write(char* dst) const
+{
+ zjson_snapshot_header h;
+ memcpy(h.magic, __snapshot_magic__, sizeof(h.magic));
+ h.order=__snapshot_order__;
+ h.version=__snapshot_version__;
+ h.nodes=nodes.size();
+ h.nodes_offset=sizeof(h);
+ h.children=children.size();
+ h.children_offset=h.nodes_offset+h.nodes*sizeof(zJSONsnapshot::zjson_record);
+ h.strings_offset=h.children_offset+h.children*sizeof(uint32_t);
+ h.strings_size=strings.size();
+ h.size=h.strings_offset+h.strings_size;
+ memcpy(dst, &h, sizeof(h));
+ if(nodes.size()) memcpy(dst+h.nodes_offset, &nodes[0], nodes.size()*sizeof(zJSONsnapshot::zjson_record));
+ if(children.size()) memcpy(dst+h.children_offset, &children[0], children.size()*sizeof(uint32_t));
+ if(strings.size()) memcpy(dst+h.strings_offset, strings.data(), strings.size());
+};
+
+void zJSONsnapshot::write(std::string& ret, const zJSON& src)
+{
+ zjson_snapshot_writer w;
+ w.add(&src);
+ size_t start=ret.size();
+ ret.resize(start+w.size());
+ w.write(&ret[start]);
+};
+
+bool zJSONsnapshot::write(const char* path, const zJSON& src)
+{
+ std::string s;
+ zJSONsnapshot::write(s, src);
+ FILE* f=fopen(path, "wb");
+ if(f == NULL) return false;
+ bool b=(fwrite(s.data(), 1, s.size(), f) == s.size());
+ if(fclose(f) != 0) b=false;
+ return b;
+};
+
+bool zJSONsnapshot::freeze(const zJSON& src)
+{
+ close();
+ zjson_snapshot_writer w;
+ w.add(&src);
+ size_t n=w.size();
+ uint64_t* p= new (std::nothrow) uint64_t[(n+sizeof(uint64_t)-1)/sizeof(uint64_t)];
+ if(p == NULL) return false;
+ w.write((char*) p);
+ if(!attach((const char*) p, n)) { delete[] p; return false; }
+ m_frozen=p;
+ return true;
+};
+
+zJSONsnapshot::zJSONsnapshot():
+ m_data(NULL),
+ m_size(0),
+ m_map(NULL),
+ m_file(NULL),
+ m_frozen(NULL),
+ m_nodes(NULL),
+ m_count(0),
+ m_children(NULL),
+ m_children_count(0),
+ m_strings(NULL),
+ m_strings_size(0)
+{
+};
+
+zJSONsnapshot::~zJSONsnapshot() { close(); };
+
+bool zJSONsnapshot::attach(const char* data, size_t len)
+{
+ const zjson_snapshot_header* h=(const zjson_snapshot_header*) data;
+ if(data == NULL || len < sizeof(zjson_snapshot_header) || (((size_t) data) & 7) != 0) return false;
+ if(memcmp(h->magic, __snapshot_magic__, sizeof(h->magic)) != 0) return false;
+ if(h->order != __snapshot_order__ || h->version == 0 || h->version > __snapshot_version__ || h->size > len) return false;
+ if(h->nodes == 0 || h->nodes_offset > h->size || (h->nodes_offset & 7) != 0) return false;
+ if(h->nodes > (h->size-h->nodes_offset)/sizeof(zjson_record)) return false;
+ if(h->children_offset > h->size || (h->children_offset & 3) != 0) return false;
+ if(h->children > (h->size-h->children_offset)/sizeof(uint32_t)) return false;
+ if(h->strings_offset > h->size || h->strings_size > (h->size-h->strings_offset)) return false;
+ m_data=data;
+ m_size=len;
+ m_nodes=(const zjson_record*) (data+h->nodes_offset);
+ m_count=h->nodes;
+ m_children=(const uint32_t*) (data+h->children_offset);
+ m_children_count=h->children;
+ m_strings=data+h->strings_offset;
+ m_strings_size=h->strings_size;
+ return true;
+};
+
+bool zJSONsnapshot::open(const char* data, size_t len)
+{
+ close();
+ return attach(data, len);
+};
+
+#ifdef _WIN32
+
+bool zJSONsnapshot::open(const char* path)
+{
+ close();
+ HANDLE f=CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+ if(f == INVALID_HANDLE_VALUE) return false;
+ LARGE_INTEGER n;
+ if(!GetFileSizeEx(f, &n) || n.QuadPart == 0) { CloseHandle(f); return false; }
+ HANDLE m=CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+ if(m == NULL) { CloseHandle(f); return false; }
+ const char* p=(const char*) MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+ if(p == NULL || !attach(p, (size_t) n.QuadPart))
+ {
+  if(p) UnmapViewOfFile(p);
+  CloseHandle(m);
+  CloseHandle(f);
+  return false;
+ }
+ m_map=m;
+ m_file=f;
+ return true;
+};
+
+void zJSONsnapshot::close()
+{
+ if(m_map)
+ {
+  UnmapViewOfFile(m_data);
+  CloseHandle((HANDLE) m_map);
+  CloseHandle((HANDLE) m_file);
+ }
+ delete[] m_frozen;
+ m_map=NULL;
+ m_file=NULL;
+ m_frozen=NULL;
+ m_data=NULL;
+ m_size=0;
+ m_nodes=NULL;
+ m_count=0;
+ m_children=NULL;
+ m_children_count=0;
+ m_strings=NULL;
+ m_strings_size=0;
+};
+
+#else
+
+bool zJSONsnapshot::open(const char* path)
+{
+ close();
+ int fd=::open(path, O_RDONLY);
+ if(fd < 0) return false;
+ struct stat st;
+ if(fstat(fd, &st) != 0 || st.st_size <= 0) { ::close(fd); return false; }
+ size_t n=(size_t) st.st_size;
+ void* p=mmap(NULL, n, PROT_READ, MAP_SHARED, fd, 0);
+ ::close(fd);
+ if(p == MAP_FAILED) return false;
+ if(!attach((const char*) p, n)) { munmap(p, n); return false; }
+ m_map=p;
+ return true;
+};
+
+void zJSONsnapshot::close()
+{
+ if(m_map) munmap(m_map, m_size);
+ delete[] m_frozen;
+ m_map=NULL;
+ m_file=NULL;
+ m_frozen=NULL;
+ m_data=NULL;
+ m_size=0;
+ m_nodes=NULL;
+ m_count=0;
+ m_children=NULL;
+ m_children_count=0;
+ m_strings=NULL;
+ m_strings_size=0;
+};
+
+#endif
+
+size_t zJSONsnapshot::string_size(uint64_t pos) const
+{
+ uint32_t n;
+ if(pos < sizeof(n) || pos >= m_strings_size) return 0;
+ memcpy(&n, m_strings+pos-sizeof(n), sizeof(n));
+ if(n >= (m_strings_size-pos)) return 0;
+ return n;
+};
+
+size_t zJSONsnapshot::zNodeJSON::length() const
+{
+ if(type() != zJSON::JSON_STRING || m_rec->value >= m_doc->m_strings_size) return 0;
+ if(m_rec->size >= (m_doc->m_strings_size-m_rec->value)) return 0;
+ return (size_t) m_rec->size;
+};
+
+size_t zJSONsnapshot::zNodeJSON::size() const
+{
+ if(type() != zJSON::JSON_ARRAY && type() != zJSON::JSON_NODE) return 0;
+ if(m_rec->value > m_doc->m_children_count || m_rec->size > (m_doc->m_children_count-m_rec->value)) return 0;
+ return (size_t) m_rec->size;
+};
+
+zJSONsnapshot::zNodeJSON zJSONsnapshot::zNodeJSON::at(size_t pos) const
+{
+ if(pos >= size()) return zNodeJSON();
+ uint64_t n=m_doc->m_children[m_rec->value+pos];
+ if(n <= (uint64_t) (m_rec-m_doc->m_nodes)) return zNodeJSON();
+ return m_doc->record(n);
+};
+
+size_t zJSONsnapshot::zNodeJSON::find(const std::string& json_name, size_t start_pos) const
+{
+ size_t n=size();
+ for(size_t i=start_pos; i < n; i++)
+ {
+  zNodeJSON p=at(i);
+  if(p.valid() && p.name_size() == json_name.size() && memcmp(p.name(), json_name.data(), json_name.size()) == 0) return i;
+ }
+ return std::string::npos;
+};
+
+bool zJSONsnapshot::zNodeJSON::as_boolean() const
+{
+ switch(type())
+ {
+  case zJSON::JSON_BOOLEAN:
+  case zJSON::JSON_INTEGER: { return (m_rec->value != 0); }
+  case zJSON::JSON_NUMBER: { return (bool) as_number(); }
+  case zJSON::JSON_STRING: { return (length() != 0); }
+ }
+ return (size() != 0);
+};
+
+int64_t zJSONsnapshot::zNodeJSON::as_integer() const
+{
+ switch(type())
+ {
+  case zJSON::JSON_BOOLEAN: { return (m_rec->value)?(1):(0); }
+  case zJSON::JSON_INTEGER: { return (m_rec->size)?(INT64_MAX):((int64_t) m_rec->value); }
+  case zJSON::JSON_NUMBER: { return (int64_t) as_number(); }
+  case zJSON::JSON_STRING: { return zJSON::toInteger(as_string()); }
+ }
+ return (int64_t) size();
+};
+
+double zJSONsnapshot::zNodeJSON::as_number() const
+{
+ double ret;
+ switch(type())
+ {
+  case zJSON::JSON_BOOLEAN: { return (m_rec->value)?(1.0):(0.0); }
+  case zJSON::JSON_INTEGER: { return (m_rec->size)?((double) m_rec->value):((double) (int64_t) m_rec->value); }
+  case zJSON::JSON_NUMBER: { memcpy(&ret, &m_rec->value, sizeof(ret)); return ret; }
+  case zJSON::JSON_STRING: { return zJSON::toDouble(as_string()); }
+ }
+ return (double) size();
+};
+
+std::string zJSONsnapshot::zNodeJSON::as_string() const
+{
+ std::string ret;
+ as_string(ret);
+ return ret;
+};
+
+bool zJSONsnapshot::zNodeJSON::as_string(std::string& ret) const
+{
+ switch(type())
+ {
+  case zJSON::JSON_BOOLEAN: { ret=(m_rec->value)?("true"):("false"); return true; }
+  case zJSON::JSON_INTEGER: { ret=(m_rec->size)?(zJSON::toString(m_rec->value)):(zJSON::toString(as_integer())); return true; }
+  case zJSON::JSON_NUMBER: { ret=zJSON::toString(as_number()); return true; }
+  case zJSON::JSON_STRING: { ret.assign(c_str(), length()); return true; }
+ }
+ ret="";
+ return false;
+};
+
+zJSON* zJSONsnapshot::zNodeJSON::copy_value() const
+{
+ std::string json_name(name(), name_size());
+ switch(type())
+ {
+  case zJSON::JSON_BOOLEAN: { return new zJSON(json_name, as_boolean()); }
+  case zJSON::JSON_INTEGER:
+  {
+   if(m_rec->size) return new zJSON(json_name, m_rec->value);
+   return new zJSON(json_name, as_integer());
+  }
+  case zJSON::JSON_NUMBER: { return new zJSON(json_name, as_number()); }
+  case zJSON::JSON_STRING: { return new zJSON(json_name, std::string(c_str(), length())); }
+  case zJSON::JSON_ARRAY:
+  case zJSON::JSON_NODE:
+  {
+   zJSON* ret= new zJSON(type(), json_name);
+   ret->reserve(size());
+   return ret;
+  }
+ }
+ return new zJSON(zJSON::JSON_NULL, json_name);
+};
+
+struct zjson_snapshot_copy_frame
+{
+ zJSONsnapshot::zNodeJSON src;
+ zJSON* dst;
+ size_t pos;
+ size_t size;
+};
+
+zJSON* zJSONsnapshot::zNodeJSON::copy() const
+{
+ if(m_rec == NULL) return NULL;
+ std::vector<zjson_snapshot_copy_frame> stack;
+ zjson_snapshot_copy_frame f;
+ f.src=*this;
+ f.dst=copy_value();
+ f.pos=0;
+ f.size=size();
+ zJSON* ret=f.dst;
+ if(f.size) stack.push_back(f);
+ while(!stack.empty())
+ {
+  zjson_snapshot_copy_frame& top=stack.back();
+  if(top.pos == top.size)
+  {
+   zJSON* p=top.dst;
+   stack.pop_back();
+   if(!stack.empty()) stack.back().dst->push_back(p);
+   continue;
+  }
+  f.src=top.src.at(top.pos++);
+  if(!f.src.valid()) continue;
+  f.dst=f.src.copy_value();
+  f.size=f.src.size();
+  if(f.size) stack.push_back(f);
+  else top.dst->push_back(f.dst);
+ }
+ return ret;
+};
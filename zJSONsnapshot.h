@@ -0,0 +1,174 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __zJSONsnapshot_h
+#define __zJSONsnapshot_h 1
+
+#include <string.h>
+
+#include "zJSON.h"
+
+/*
+zJSONsnapshot is the read-only binary image of the zJSON tree. The image consists of the flat node table (objects are placed
+in depth-first order), the child index table and the string pool. The image is written once from the zJSON tree and opened
+without parsing and without allocation per object. The snapshot file is mapped read-only into memory, so the same pages are
+shared through the page cache by all processes which open the file. The image is never changed after it is opened, so the
+objects of one snapshot can be read by many threads at the same time without locking.
+*/
+
+class ZJSON_API zJSONsnapshot
+{
+public:
+
+ struct zjson_record
+ {
+  uint32_t type;
+  uint32_t parent;
+  uint64_t name;
+  uint64_t value;
+  uint64_t size;
+ };
+
+ class zNodeJSON
+ {
+  public:
+   zNodeJSON(): m_doc(NULL), m_rec(NULL) {};
+   zNodeJSON(const zJSONsnapshot* doc, const zjson_record* rec): m_doc(doc), m_rec(rec) {};
+
+   bool valid() const { return (m_rec != NULL); };
+/*
+Returns false if the object is not found (the analog of NULL pointer of zJSON).
+*/
+   int type() const { return (m_rec)?((int) m_rec->type):(zJSON::JSON_NULL); };
+/*
+Returns type of object: enum { JSON_NULL=0, JSON_BOOLEAN, JSON_INTEGER, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_NODE }.
+*/
+   const char* name() const { return (m_rec)?(m_doc->string(m_rec->name)):(""); };
+   size_t name_size() const { return (m_rec)?(m_doc->string_size(m_rec->name)):(0); };
+/*
+Returns pointer to object name (zero terminated) and its size.
+*/
+   zNodeJSON parent() const { return (m_rec)?(m_doc->record(m_rec->parent)):(zNodeJSON()); };
+/*
+Returns parent object. If no parent, returns invalid object.
+*/
+   bool as_boolean() const;
+   int64_t as_integer() const;
+   double as_number() const;
+   std::string as_string() const;
+   bool as_string(std::string& ret) const;
+/*
+Returns copy of plain type from JSON object. The function tries to convert native value to result.
+*/
+   const char* c_str() const { return (type() == zJSON::JSON_STRING)?(m_doc->string(m_rec->value)):(""); };
+   size_t length() const;
+/*
+Returns pointer to the value of JSON_STRING (zero terminated) and its length without copying.
+*/
+   zNodeJSON operator[](size_t pos) const { return at(pos); };
+   zNodeJSON at(size_t pos) const;
+   zNodeJSON front() const { return at(0); };
+   zNodeJSON back() const { return at(size()-1); };
+/*
+Returns object are placed at pos. If object is not found the function returns invalid object.
+*/
+   size_t find(const std::string& json_name, size_t start_pos=0) const;
+   zNodeJSON search(const std::string& json_name, size_t start_pos=0) const { return at(find(json_name, start_pos)); };
+/*
+Searches object with json_name through the children starting start_pos. The functions return std::string::npos and invalid
+object if the child does not exist.
+*/
+   bool empty() const { return (size() == 0); };
+   size_t size() const;
+/*
+Returns the number of children that the object has. The function returns 0 for anything other than JSON_ARRAY or JSON_NODE.
+*/
+   zJSON* copy() const;
+/*
+Returns new zJSON tree which is the copy of the object. If object is invalid the function returns NULL.
+*/
+
+  protected:
+   const zJSONsnapshot* m_doc;
+   const zjson_record* m_rec;
+
+   zJSON* copy_value() const;
+ };
+
+ zJSONsnapshot();
+ virtual ~zJSONsnapshot();
+
+static void write(std::string& ret, const zJSON& src);
+static bool write(const char* path, const zJSON& src);
+/*
+Writes the snapshot image of the src tree to ret (appends) or to the file path.
+Returns true if successfully , false if unsuccessfully.
+*/
+ bool open(const char* path);
+ bool open(const char* data, size_t len);
+/*
+Opens the snapshot file (the file is mapped read-only into memory) or the snapshot image placed in memory. The image in memory
+must be aligned to 8 bytes and must not be released while the snapshot is opened.
+Returns true if successfully , false if unsuccessfully.
+*/
+ bool freeze(const zJSON& src);
+/*
+Builds the snapshot image of the src tree in one block of memory owned by the snapshot and opens it (the frozen copy of the
+tree). The src tree is not changed and may be deleted after the call.
+Returns true if successfully , false if unsuccessfully.
+*/
+ void close();
+/*
+Closes the snapshot. All objects of the snapshot become invalid.
+*/
+ bool is_open() const { return (m_nodes != NULL); };
+ zNodeJSON root() const { return record(0); };
+/*
+Returns the root object. If the snapshot is not opened the function returns invalid object.
+*/
+ size_t count() const { return (size_t) m_count; };
+/*
+Returns the number of objects in the snapshot.
+*/
+
+protected:
+
+ const char* m_data;
+ size_t m_size;
+ void* m_map;
+ void* m_file;
+ uint64_t* m_frozen;
+
+ const zjson_record* m_nodes;
+ uint64_t m_count;
+ const uint32_t* m_children;
+ uint64_t m_children_count;
+ const char* m_strings;
+ uint64_t m_strings_size;
+
+ bool attach(const char* data, size_t len);
+ zNodeJSON record(uint64_t pos) const { return (pos < m_count)?(zNodeJSON(this, m_nodes+pos)):(zNodeJSON()); };
+ const char* string(uint64_t pos) const { return (pos < m_strings_size)?(m_strings+pos):(""); };
+ size_t string_size(uint64_t pos) const;
+
+private:
+ zJSONsnapshot(const zJSONsnapshot& src);
+ zJSONsnapshot& operator=(const zJSONsnapshot& src);
+};
+
+#endif //__zJSONsnapshot_h
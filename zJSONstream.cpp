@@ -0,0 +1,975 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ostream>
+#include <algorithm>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "zJSON.h"
+
+extern bool zjson_exact_integer(const zJSON& src, bool& negative, uint64_t& magnitude);
+
+#ifdef ZJSON_STATS
+extern zJSON::zStatsJSON& zjson_stats_call();
+extern uint64_t zjson_stats_begin();
+extern void zjson_stats_end(int phase, uint64_t start);
+
+#define ZJSON_STATS_NODE(json_type) ++zjson_stats_call().nodes[json_type];
+#define ZJSON_STATS_DEPTH(depth) { if((depth) > zjson_stats_call().max_depth) zjson_stats_call().max_depth=(depth); }
+#define ZJSON_STATS_BYTES(n) zjson_stats_call().bytes+=(n);
+#else
+#define ZJSON_STATS_NODE(json_type)
+#define ZJSON_STATS_DEPTH(depth)
+#define ZJSON_STATS_BYTES(n)
+#endif
+
+/*
+Streaming writer and the formatted writer: the tree is walked without recursion, the text is collected in the buffer of
+fixed size and passed to the sink every time the buffer is full (write_formatted to std::string has no sink, the text is
+appended to the result). The indentation is appended from the prepared string of indent characters.
+Parallel writer: the top of the tree is planned into the ordered list of tasks (the text of opened and closed containers,
+whole subtrees and ranges of children of large containers), the threads take the tasks by the shared counter and write
+every task into its own buffer, the calling thread passes the finished buffers on in order.
+Canonical writer: the same walk, the members of every JSON_NODE are visited through the sorted range of pointers which is
+pushed to the shared array when the container is opened and dropped when it is closed.
+*/
+
+bool zJSON::zFileJSON::write(const char* data, size_t len)
+{
+ if(m_file) return (fwrite(data, 1, len, m_file) == len);
+ while(len)
+ {
+#ifdef _WIN32
+  int n=::_write(m_fd, data, (len > 0x40000000)?(0x40000000):((unsigned) len));
+#else
+  ssize_t n=::write(m_fd, data, len);
+#endif
+  if(n < 0 && errno == EINTR) continue;
+  if(n <= 0) return false;
+  data+=n;
+  len-=(size_t) n;
+ }
+ return true;
+};
+
+long zJSON::zFileJSON::read(char* data, size_t len)
+{
+ if(len > 0x40000000) len=0x40000000;
+ if(m_file)
+ {
+  size_t n=fread(data, 1, len, m_file);
+  return (n == 0 && ferror(m_file))?(-1):((long) n);
+ }
+ for(;;)
+ {
+#ifdef _WIN32
+  int n=::_read(m_fd, data, (unsigned) len);
+#else
+  ssize_t n=::read(m_fd, data, len);
+#endif
+  if(n < 0 && errno == EINTR) continue;
+  return (n < 0)?(-1):((long) n);
+ }
+};
+
+class zjson_ostream_sink: public zJSON::zSinkJSON
+{
+ public:
+  zjson_ostream_sink(std::ostream& os): m_os(os) {};
+  virtual bool write(const char* data, size_t len) { m_os.write(data, (std::streamsize) len); return m_os.good(); };
+
+ private:
+  std::ostream& m_os;
+};
+
+struct zjson_stream_frame
+{
+ const zJSON* p;
+ size_t pos;
+};
+
+class zjson_stream_indent
+{
+ public:
+  zjson_stream_indent(const zJSON::zFormatJSON& fmt): m_width(fmt.indent), m_char((fmt.tabs)?('\t'):(' ')), m_pad(64*fmt.indent, m_char) {};
+  void append(std::string& ret, size_t level)
+  {
+   size_t n=level*m_width;
+   if(n > m_pad.size()) m_pad.resize(std::max(n, 2*m_pad.size()), m_char);
+   ret.append(m_pad.data(), n);
+  };
+
+ private:
+  size_t m_width;
+  char m_char;
+  std::string m_pad;
+};
+
+static bool stream_named(const zJSON* p) { return (p->name().size() && ((p->parent())?(p->parent()->type() != zJSON::JSON_ARRAY):true)); };
+
+static bool stream_container(const zJSON* p) { return (p->type() == zJSON::JSON_ARRAY || p->type() == zJSON::JSON_NODE); };
+
+static bool stream_compact(const zJSON* p, const zJSON::zFormatJSON* fmt)
+{
+ if(fmt == NULL || !fmt->compact_arrays || p->type() != zJSON::JSON_ARRAY) return false;
+ for(size_t i=0, n=p->size(); i < n; i++) { if(stream_container(p->at(i))) return false; }
+ return true;
+};
+
+static void stream_name(std::string& ret, const zJSON* p, zjson_stream_indent& indent, size_t level)
+{
+ indent.append(ret, level);
+ if(!stream_named(p)) return;
+ ret+='\"';
+ zJSON::escape(ret, p->name().c_str(), p->name().size());
+ ret.append("\" : ", 4);
+};
+
+static void stream_plain(std::string& ret, const zJSON* p)
+{
+ switch(p->type())
+ {
+  case zJSON::JSON_NULL: { ret.append("null", 4); return; }
+  case zJSON::JSON_BOOLEAN: { if(*p->ptr_boolean()) ret.append("true", 4); else ret.append("false", 5); return; }
+  case zJSON::JSON_INTEGER:
+  {
+   const std::string* raw=p->ptr_raw();
+   if(raw) ret+=*raw; else ret+=zJSON::toString(*p->ptr_integer());
+   return;
+  }
+  case zJSON::JSON_NUMBER:
+  {
+   const std::string* raw=p->ptr_raw();
+   if(raw) ret+=*raw; else ret+=zJSON::toString(*p->ptr_number());
+   return;
+  }
+  case zJSON::JSON_STRING:
+  {
+   const std::string& s=*p->ptr_string();
+   ret+='\"';
+   zJSON::escape(ret, s.c_str(), s.size());
+   ret+='\"';
+   return;
+  }
+ }
+};
+
+static void stream_compact_plain(std::string& ret, const zJSON* p)
+{
+ if(stream_named(p))
+ {
+  ret+='\"';
+  zJSON::escape(ret, p->name().c_str(), p->name().size());
+  if(p->type() == zJSON::JSON_NULL) ret.append("\":", 2);
+  else ret.append("\" : ", 4);
+ }
+ stream_plain(ret, p);
+};
+
+static void stream_open(std::string& ret, const zJSON* p, zjson_stream_indent* indent, size_t level)
+{
+ char c=(p->type() == zJSON::JSON_ARRAY)?('['):('{');
+ if(indent == NULL)
+ {
+  if(stream_named(p)) { ret+='\"'; zJSON::escape(ret, p->name().c_str(), p->name().size()); ret.append("\":", 2); }
+  ret+=c;
+  return;
+ }
+ if(stream_named(p)) { indent->append(ret, level); ret+='\"'; zJSON::escape(ret, p->name().c_str(), p->name().size()); ret.append("\" :\n", 4); }
+ indent->append(ret, level);
+ ret+=c;
+ ret+='\n';
+};
+
+static void stream_close(std::string& ret, const zJSON* p, zjson_stream_indent* indent, size_t level)
+{
+ if(indent) { ret+='\n'; indent->append(ret, level); }
+ ret+=(p->type() == zJSON::JSON_ARRAY)?(']'):('}');
+};
+
+static bool stream_flush(zJSON::zSinkJSON* sink, std::string& buffer)
+{
+ if(sink == NULL) return true;
+ ZJSON_STATS_BYTES(buffer.size())
+ bool ret=(buffer.empty() || sink->write(buffer.data(), buffer.size()));
+ buffer.clear();
+ return ret;
+};
+
+static bool stream_walk(const zJSON* root, zJSON::zSinkJSON* sink, std::string& buffer, size_t buffer_size, const zJSON::zFormatJSON* fmt)
+{
+ std::vector<zjson_stream_frame> stack;
+ zjson_stream_frame f;
+ zjson_stream_indent pad((fmt)?(*fmt):(zJSON::zFormatJSON()));
+ zjson_stream_indent* indent=(fmt)?(&pad):(NULL);
+ const zJSON* p=root;
+#ifdef ZJSON_STATS
+ size_t base=buffer.size();
+#endif
+ if(buffer_size == 0) buffer_size=1;
+ if(sink) buffer.reserve(buffer_size);
+ for(;;)
+ {
+  ZJSON_STATS_NODE(p->type())
+  if(stream_compact(p, fmt))
+  {
+   ZJSON_STATS_DEPTH(stack.size()+1)
+   stream_name(buffer, p, pad, stack.size());
+   buffer+='[';
+   for(size_t i=0, n=p->size(); i < n; i++)
+   {
+    ZJSON_STATS_NODE(p->at(i)->type())
+    if(i) buffer.append(", ", 2);
+    stream_plain(buffer, p->at(i));
+    if(buffer.size() >= buffer_size && !stream_flush(sink, buffer)) return false;
+   }
+   buffer+=']';
+  }
+  else if(stream_container(p))
+  {
+   stream_open(buffer, p, indent, stack.size());
+   ZJSON_STATS_DEPTH(stack.size()+1)
+   if(p->size())
+   {
+    f.p=p;
+    f.pos=0;
+    stack.push_back(f);
+    p=p->at(0);
+    continue;
+   }
+   stream_close(buffer, p, indent, stack.size());
+  }
+  else if(indent) { stream_name(buffer, p, pad, stack.size()); stream_plain(buffer, p); }
+  else stream_compact_plain(buffer, p);
+
+  for(;;)
+  {
+   if(buffer.size() >= buffer_size && !stream_flush(sink, buffer)) return false;
+   if(stack.empty())
+   {
+    if(sink == NULL) { ZJSON_STATS_BYTES(buffer.size()-base) }
+    return stream_flush(sink, buffer);
+   }
+   zjson_stream_frame& top=stack.back();
+   if(++top.pos < top.p->size())
+   {
+    if(indent) buffer.append(",\n", 2);
+    else buffer+=',';
+    p=top.p->at(top.pos);
+    break;
+   }
+   p=top.p;
+   stack.pop_back();
+   stream_close(buffer, p, indent, stack.size());
+  }
+ }
+};
+
+static bool stream_write(const zJSON* root, zJSON::zSinkJSON* sink, std::string& buffer, size_t buffer_size, const zJSON::zFormatJSON* fmt)
+{
+#ifdef ZJSON_STATS
+ uint64_t start=zjson_stats_begin();
+ bool ret=stream_walk(root, sink, buffer, buffer_size, fmt);
+ zjson_stats_end(zJSON::zStatsJSON::PHASE_WRITE, start);
+ return ret;
+#else
+ return stream_walk(root, sink, buffer, buffer_size, fmt);
+#endif
+};
+
+void zJSON::write(std::string& ret) const { stream_write(this, NULL, ret, std::string::npos, NULL); };
+
+enum { PARALLEL_TEXT=0, PARALLEL_TREE, PARALLEL_RANGE };
+
+static const size_t __parallel_tasks__ = 64;
+static const size_t __parallel_depth__ = 8;
+static const size_t __parallel_nodes__ = 8192;
+
+struct zjson_parallel_task
+{
+ int kind;
+ const zJSON* p;
+ size_t first;
+ size_t last;
+ size_t depth;
+ std::string text;
+ int done;
+#ifdef ZJSON_STATS
+ zJSON::zStatsJSON stats;
+#endif
+};
+
+class zjson_parallel_job
+{
+ public:
+  zjson_parallel_job(size_t threads): m_threads(threads), m_tasks(), m_work(0), m_next(0), m_stop(0) {};
+  ~zjson_parallel_job() { for(size_t i=0; i < m_tasks.size(); i++) delete m_tasks[i]; };
+
+  void plan(const zJSON* root);
+  bool run(zJSON::zSinkJSON* sink, std::string& ret);
+  static void* worker(void* arg);
+
+ private:
+  size_t m_threads;
+  std::vector<zjson_parallel_task*> m_tasks;
+  size_t m_work;
+  size_t m_next;
+  int m_stop;
+
+  zjson_parallel_task* add(int kind, const zJSON* p, size_t first, size_t last, size_t depth);
+  std::string& text();
+  void work();
+  void execute(zjson_parallel_task* t);
+  bool flush(zJSON::zSinkJSON* sink, size_t& flushed);
+};
+
+zjson_parallel_task* zjson_parallel_job::add(int kind, const zJSON* p, size_t first, size_t last, size_t depth)
+{
+ zjson_parallel_task* t= new zjson_parallel_task;
+ t->kind=kind;
+ t->p=p;
+ t->first=first;
+ t->last=last;
+ t->depth=depth;
+ t->done=(kind == PARALLEL_TEXT);
+ if(kind != PARALLEL_TEXT) ++m_work;
+#ifdef ZJSON_STATS
+ t->stats.clear();
+#endif
+ m_tasks.push_back(t);
+ return t;
+};
+
+std::string& zjson_parallel_job::text()
+{
+ if(m_tasks.empty() || m_tasks.back()->kind != PARALLEL_TEXT) add(PARALLEL_TEXT, NULL, 0, 0, 0);
+ return m_tasks.back()->text;
+};
+
+void zjson_parallel_job::plan(const zJSON* root)
+{
+ std::vector<zjson_stream_frame> stack;
+ zjson_stream_frame f;
+ const zJSON* p=root;
+ size_t limit=m_threads*__parallel_tasks__;
+ for(;;)
+ {
+  size_t n=p->size();
+  if(!stream_container(p)) { ZJSON_STATS_NODE(p->type()) stream_compact_plain(text(), p); }
+  else if(n == 0)
+  {
+   ZJSON_STATS_NODE(p->type())
+   ZJSON_STATS_DEPTH(stack.size()+1)
+   stream_open(text(), p, NULL, 0);
+   stream_close(text(), p, NULL, 0);
+  }
+  else if(m_tasks.size() > limit || stack.size() >= __parallel_depth__) add(PARALLEL_TREE, p, 0, 0, stack.size());
+  else
+  {
+   ZJSON_STATS_NODE(p->type())
+   ZJSON_STATS_DEPTH(stack.size()+1)
+   stream_open(text(), p, NULL, 0);
+   if(n < m_threads)
+   {
+    f.p=p;
+    f.pos=0;
+    stack.push_back(f);
+    p=p->at(0);
+    continue;
+   }
+   size_t chunks=std::min(n, m_threads*8);
+   for(size_t i=0; i < chunks; i++) add(PARALLEL_RANGE, p, n*i/chunks, n*(i+1)/chunks, stack.size()+1);
+   stream_close(text(), p, NULL, 0);
+  }
+
+  for(;;)
+  {
+   if(stack.empty()) return;
+   zjson_stream_frame& top=stack.back();
+   if(++top.pos < top.p->size())
+   {
+    text()+=',';
+    p=top.p->at(top.pos);
+    break;
+   }
+   p=top.p;
+   stack.pop_back();
+   stream_close(text(), p, NULL, 0);
+  }
+ }
+};
+
+void zjson_parallel_job::execute(zjson_parallel_task* t)
+{
+#ifdef ZJSON_STATS
+ zJSON::zStatsJSON& s=zjson_stats_call();
+ zJSON::zStatsJSON call=s;
+ s.clear();
+#endif
+ if(t->kind == PARALLEL_TREE) stream_walk(t->p, NULL, t->text, std::string::npos, NULL);
+ else
+ {
+  for(size_t i=t->first; i < t->last; i++)
+  {
+   if(i) t->text+=',';
+   stream_walk(t->p->at(i), NULL, t->text, std::string::npos, NULL);
+  }
+ }
+#ifdef ZJSON_STATS
+ t->stats=s;
+ t->stats.max_depth+=t->depth;
+ s=call;
+#endif
+};
+
+bool zjson_parallel_job::flush(zJSON::zSinkJSON* sink, size_t& flushed)
+{
+ while(flushed < m_tasks.size() && __atomic_load_n(&m_tasks[flushed]->done, __ATOMIC_ACQUIRE))
+ {
+  std::string& s=m_tasks[flushed]->text;
+  ZJSON_STATS_BYTES(s.size())
+  if(s.size() && !sink->write(s.data(), s.size())) return false;
+  std::string().swap(s);
+  ++flushed;
+ }
+ return true;
+};
+
+void zjson_parallel_job::work()
+{
+ while(!__atomic_load_n(&m_stop, __ATOMIC_RELAXED))
+ {
+  size_t i=__atomic_fetch_add(&m_next, 1, __ATOMIC_RELAXED);
+  if(i >= m_tasks.size()) return;
+  if(m_tasks[i]->kind == PARALLEL_TEXT) continue;
+  execute(m_tasks[i]);
+  __atomic_store_n(&m_tasks[i]->done, 1, __ATOMIC_RELEASE);
+ }
+};
+
+void* zjson_parallel_job::worker(void* arg)
+{
+ static_cast<zjson_parallel_job*>(arg)->work();
+ return NULL;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI parallel_thread(LPVOID arg) { zjson_parallel_job::worker(arg); return 0; };
+
+static size_t parallel_threads()
+{
+ SYSTEM_INFO si;
+ GetSystemInfo(&si);
+ return (si.dwNumberOfProcessors)?((size_t) si.dwNumberOfProcessors):(1);
+};
+#else
+static size_t parallel_threads()
+{
+ long n=sysconf(_SC_NPROCESSORS_ONLN);
+ return (n > 0)?((size_t) n):(1);
+};
+#endif
+
+bool zjson_parallel_job::run(zJSON::zSinkJSON* sink, std::string& ret)
+{
+ bool b=true;
+ size_t flushed=0, n=m_tasks.size(), start=ret.size();
+ m_threads=std::min(m_threads, m_work);
+#ifdef _WIN32
+ std::vector<HANDLE> threads;
+ for(size_t i=1; i < m_threads; i++)
+ {
+  HANDLE h=CreateThread(NULL, 0, parallel_thread, this, 0, NULL);
+  if(h == NULL) break;
+  threads.push_back(h);
+ }
+#else
+ std::vector<pthread_t> threads;
+ for(size_t i=1; i < m_threads; i++)
+ {
+  pthread_t h;
+  if(pthread_create(&h, NULL, zjson_parallel_job::worker, this) != 0) break;
+  threads.push_back(h);
+ }
+#endif
+ for(;;)
+ {
+  size_t i=__atomic_fetch_add(&m_next, 1, __ATOMIC_RELAXED);
+  if(i >= n) break;
+  if(m_tasks[i]->kind != PARALLEL_TEXT) { execute(m_tasks[i]); __atomic_store_n(&m_tasks[i]->done, 1, __ATOMIC_RELEASE); }
+  if(sink && !flush(sink, flushed)) { b=false; __atomic_store_n(&m_stop, 1, __ATOMIC_RELAXED); break; }
+ }
+#ifdef _WIN32
+ for(size_t i=0; i < threads.size(); i++) { WaitForSingleObject(threads[i], INFINITE); CloseHandle(threads[i]); }
+#else
+ for(size_t i=0; i < threads.size(); i++) pthread_join(threads[i], NULL);
+#endif
+#ifdef ZJSON_STATS
+ for(size_t i=0; i < n; i++)
+ {
+  const zJSON::zStatsJSON& t=m_tasks[i]->stats;
+  for(int k=0; k <= zJSON::JSON_NODE; k++) zjson_stats_call().nodes[k]+=t.nodes[k];
+  ZJSON_STATS_DEPTH(t.max_depth)
+ }
+#endif
+ if(sink) return (b && flush(sink, flushed));
+ size_t len=0;
+ for(size_t i=0; i < n; i++) len+=m_tasks[i]->text.size();
+ ret.reserve(start+len);
+ for(size_t i=0; i < n; i++) { ret.append(m_tasks[i]->text); std::string().swap(m_tasks[i]->text); }
+ ZJSON_STATS_BYTES(len)
+ return true;
+};
+
+static bool parallel_large(const zJSON* root)
+{
+ std::vector<const zJSON*> stack(1, root);
+ size_t n=0;
+ while(stack.size())
+ {
+  const zJSON* p=stack.back();
+  stack.pop_back();
+  ++n;
+  for(size_t i=0, k=p->size(); i < k; i++)
+  {
+   if(n+stack.size() >= __parallel_nodes__) return true;
+   stack.push_back(p->at(i));
+  }
+ }
+ return false;
+};
+
+static bool parallel_write(const zJSON* root, zJSON::zSinkJSON* sink, std::string& ret, size_t threads)
+{
+ if(threads == 0) threads=parallel_threads();
+ if(threads < 2 || !parallel_large(root)) return stream_write(root, sink, ret, (sink)?(65536):(std::string::npos), NULL);
+#ifdef ZJSON_STATS
+ uint64_t start=zjson_stats_begin();
+#endif
+ zjson_parallel_job job(threads);
+ job.plan(root);
+ bool b=job.run(sink, ret);
+#ifdef ZJSON_STATS
+ zjson_stats_end(zJSON::zStatsJSON::PHASE_WRITE, start);
+#endif
+ return b;
+};
+
+void zJSON::write_parallel(std::string& ret, size_t threads) const { parallel_write(this, NULL, ret, threads); };
+
+bool zJSON::write_parallel(zJSON::zSinkJSON& sink, size_t threads) const
+{
+ std::string buffer;
+ return parallel_write(this, &sink, buffer, threads);
+};
+
+static const char __canonical_digs__[] = "0123456789abcdef";
+static const uint64_t __canonical_exact__ = 9007199254740992ULL;
+
+struct zjson_canonical_frame
+{
+ const zJSON* p;
+ bool node;
+ size_t first;
+ size_t pos;
+ size_t size;
+};
+
+static void canonical_escape(std::string& ret, const std::string& src)
+{
+ const char* p=src.data();
+ size_t len=src.size(), run=0;
+ ret+='\"';
+ for(size_t i=0; i < len; ++i)
+ {
+  unsigned char c=(unsigned char) p[i];
+  if(c >= 0x20 && c != '\"' && c != '\\') continue;
+  ret.append(p+run, i-run);
+  run=i+1;
+  ret+='\\';
+  switch(c)
+  {
+   case '\"': { ret+='\"'; break; }
+   case '\\': { ret+='\\'; break; }
+   case '\b': { ret+='b'; break; }
+   case '\f': { ret+='f'; break; }
+   case '\n': { ret+='n'; break; }
+   case '\r': { ret+='r'; break; }
+   case '\t': { ret+='t'; break; }
+   default: { ret.append("u00", 3); ret+=__canonical_digs__[c >> 4]; ret+=__canonical_digs__[c & 0xF]; }
+  }
+ }
+ ret.append(p+run, len-run);
+ ret+='\"';
+};
+
+/*
+canonical_less compares the names by UTF-16 code units: the UTF-8 bytes are compared as is except the first byte of the
+character beyond U+FFFF (0xF0-0xF4, the surrogate pair in UTF-16) which goes before U+E000-U+FFFF (0xEE, 0xEF).
+*/
+static bool canonical_less(const zJSON* a, const zJSON* b)
+{
+ const std::string& x=a->name();
+ const std::string& y=b->name();
+ size_t n=std::min(x.size(), y.size()), i=0;
+ for(; i < n && x[i] == y[i]; ++i);
+ if(i == n) return (x.size() < y.size());
+ unsigned char c=(unsigned char) x[i], d=(unsigned char) y[i];
+ if(c >= 0xF0 && (d == 0xEE || d == 0xEF)) return true;
+ if(d >= 0xF0 && (c == 0xEE || c == 0xEF)) return false;
+ return (c < d);
+};
+
+static void canonical_sort(std::vector<const zJSON*>& order, const zJSON* p)
+{
+ size_t first=order.size(), n=p->size();
+ for(size_t i=0; i < n; i++) order.push_back(p->at(i));
+ const zJSON** v=&order[first];
+ size_t i=1;
+ for(; i < n && !canonical_less(v[i], v[i-1]); ++i);
+ if(i >= n) return;
+ if(n > 16) { std::stable_sort(order.begin()+first, order.end(), canonical_less); return; }
+ for(; i < n; ++i)
+ {
+  const zJSON* t=v[i];
+  size_t j=i;
+  for(; j && canonical_less(t, v[j-1]); --j) v[j]=v[j-1];
+  v[j]=t;
+ }
+};
+
+/*
+canonical_number writes the double like ECMAScript Number.prototype.toString: the shortest digits which read back to the
+same double, the plain notation for the decimal exponent from -6 to 20 and d.ddde+x otherwise.
+*/
+static void canonical_number(std::string& ret, double value)
+{
+ if(value != value || value > 1.7976931348623157e308 || value < -1.7976931348623157e308) { ret.append("null", 4); return; }
+ if(value == 0.0) { ret+='0'; return; }
+ char buffer[64];
+#ifdef __cpp_lib_to_chars
+ std::to_chars_result r=std::to_chars(buffer, buffer+sizeof(buffer)-1, value, std::chars_format::scientific);
+ *r.ptr='\0';
+#else
+ for(int precision=0; precision < 17; ++precision)
+ {
+  snprintf(buffer, sizeof(buffer), "%.*e", precision, value);
+  if(strtod(buffer, NULL) == value) break;
+ }
+#endif
+ char digits[32];
+ int k=0;
+ const char* s=buffer;
+ if(*s == '-') { ret+='-'; ++s; }
+ for(; *s && *s != 'e' && *s != 'E'; ++s) { if(*s >= '0' && *s <= '9' && k < 31) digits[k++]=*s; }
+ int n=((*s)?(atoi(s+1)):(0))+1;
+ for(; k > 1 && digits[k-1] == '0'; --k);
+ if(k <= n && n <= 21) { ret.append(digits, k); ret.append(n-k, '0'); return; }
+ if(0 < n && n <= 21) { ret.append(digits, n); ret+='.'; ret.append(digits+n, k-n); return; }
+ if(-6 < n && n <= 0) { ret.append("0.", 2); ret.append(-n, '0'); ret.append(digits, k); return; }
+ ret+=digits[0];
+ if(k > 1) { ret+='.'; ret.append(digits+1, k-1); }
+ ret+='e';
+ ret+=(n > 0)?('+'):('-');
+ ret+=zJSON::toString((int64_t) ((n > 0)?(n-1):(1-n)));
+};
+
+static void canonical_integer(std::string& ret, const zJSON* p)
+{
+ bool negative;
+ uint64_t magnitude;
+ if(!zjson_exact_integer(*p, negative, magnitude)) { canonical_number(ret, strtod(p->ptr_raw()->c_str(), NULL)); return; }
+ if(magnitude > __canonical_exact__) { canonical_number(ret, (negative)?(-(double) magnitude):((double) magnitude)); return; }
+ if(negative && magnitude) ret+='-';
+ ret+=zJSON::toString(magnitude);
+};
+
+static void canonical_plain(std::string& ret, const zJSON* p)
+{
+ switch(p->type())
+ {
+  case zJSON::JSON_NULL: { ret.append("null", 4); return; }
+  case zJSON::JSON_BOOLEAN: { if(*p->ptr_boolean()) ret.append("true", 4); else ret.append("false", 5); return; }
+  case zJSON::JSON_INTEGER: { canonical_integer(ret, p); return; }
+  case zJSON::JSON_NUMBER: { canonical_number(ret, p->as_number()); return; }
+  case zJSON::JSON_STRING: { canonical_escape(ret, *p->ptr_string()); return; }
+ }
+};
+
+static bool canonical_walk(const zJSON* root, zJSON::zSinkJSON* sink, std::string& buffer, size_t buffer_size)
+{
+ std::vector<zjson_canonical_frame> stack;
+ std::vector<const zJSON*> order;
+ zjson_canonical_frame f;
+ const zJSON* p=root;
+ bool named=false;
+#ifdef ZJSON_STATS
+ size_t base=buffer.size();
+#endif
+ if(buffer_size == 0) buffer_size=1;
+ if(sink) buffer.reserve(buffer_size);
+ for(;;)
+ {
+  ZJSON_STATS_NODE(p->type())
+  if(named) { canonical_escape(buffer, p->name()); buffer+=':'; }
+  if(stream_container(p))
+  {
+   f.node=(p->type() == zJSON::JSON_NODE);
+   buffer+=(f.node)?('{'):('[');
+   ZJSON_STATS_DEPTH(stack.size()+1)
+   f.size=p->size();
+   if(f.size)
+   {
+    f.p=p;
+    f.pos=0;
+    f.first=order.size();
+    if(f.node) canonical_sort(order, p);
+    stack.push_back(f);
+    named=f.node;
+    p=(f.node)?(order[f.first]):(p->at(0));
+    continue;
+   }
+   buffer+=(f.node)?('}'):(']');
+  }
+  else canonical_plain(buffer, p);
+
+  for(;;)
+  {
+   if(buffer.size() >= buffer_size && !stream_flush(sink, buffer)) return false;
+   if(stack.empty())
+   {
+    if(sink == NULL) { ZJSON_STATS_BYTES(buffer.size()-base) }
+    return stream_flush(sink, buffer);
+   }
+   zjson_canonical_frame& top=stack.back();
+   if(++top.pos < top.size)
+   {
+    buffer+=',';
+    named=top.node;
+    p=(top.node)?(order[top.first+top.pos]):(top.p->at(top.pos));
+    break;
+   }
+   bool node=top.node;
+   if(node) order.resize(top.first);
+   stack.pop_back();
+   buffer+=(node)?('}'):(']');
+  }
+ }
+};
+
+static bool canonical_write(const zJSON* root, zJSON::zSinkJSON* sink, std::string& buffer, size_t buffer_size)
+{
+#ifdef ZJSON_STATS
+ uint64_t start=zjson_stats_begin();
+ bool ret=canonical_walk(root, sink, buffer, buffer_size);
+ zjson_stats_end(zJSON::zStatsJSON::PHASE_WRITE, start);
+ return ret;
+#else
+ return canonical_walk(root, sink, buffer, buffer_size);
+#endif
+};
+
+void zJSON::write_canonical(std::string& ret) const { canonical_write(this, NULL, ret, std::string::npos); };
+
+bool zJSON::write_canonical(zJSON::zSinkJSON& sink, size_t buffer_size) const
+{
+ std::string buffer;
+ return canonical_write(this, &sink, buffer, buffer_size);
+};
+
+void zJSON::write_formatted(std::string& ret) const
+{
+ zJSON::zFormatJSON fmt;
+ stream_write(this, NULL, ret, std::string::npos, &fmt);
+};
+
+void zJSON::write_formatted(std::string& ret, const zJSON::zFormatJSON& fmt) const { stream_write(this, NULL, ret, std::string::npos, &fmt); };
+
+bool zJSON::write(zJSON::zSinkJSON& sink, size_t buffer_size) const
+{
+ std::string buffer;
+ return stream_write(this, &sink, buffer, buffer_size, NULL);
+};
+
+bool zJSON::write(std::ostream& os, size_t buffer_size) const
+{
+ zjson_ostream_sink sink(os);
+ return write(sink, buffer_size);
+};
+
+bool zJSON::write(FILE* f, size_t buffer_size) const
+{
+ if(f == NULL) return false;
+ zJSON::zFileJSON sink(f);
+ return write(sink, buffer_size);
+};
+
+bool zJSON::write(int fd, size_t buffer_size) const
+{
+ if(fd < 0) return false;
+ zJSON::zFileJSON sink(fd);
+ return write(sink, buffer_size);
+};
+
+bool zJSON::write_formatted(zJSON::zSinkJSON& sink, size_t buffer_size, const zJSON::zFormatJSON& fmt) const
+{
+ std::string buffer;
+ return stream_write(this, &sink, buffer, buffer_size, &fmt);
+};
+
+bool zJSON::write_formatted(std::ostream& os, size_t buffer_size, const zJSON::zFormatJSON& fmt) const
+{
+ zjson_ostream_sink sink(os);
+ return write_formatted(sink, buffer_size, fmt);
+};
+
+bool zJSON::write_formatted(FILE* f, size_t buffer_size, const zJSON::zFormatJSON& fmt) const
+{
+ if(f == NULL) return false;
+ zJSON::zFileJSON sink(f);
+ return write_formatted(sink, buffer_size, fmt);
+};
+
+bool zJSON::write_formatted(int fd, size_t buffer_size, const zJSON::zFormatJSON& fmt) const
+{
+ if(fd < 0) return false;
+ zJSON::zFileJSON sink(fd);
+ return write_formatted(sink, buffer_size, fmt);
+};
+
+zJSON::zReaderJSON::zReaderJSON(zJSON::zSourceJSON& src, const zJSON::zOptionJSON& opt, size_t block_size):
+ m_src(src),
+ m_opt(opt),
+ m_block((block_size)?(block_size):(1)),
+ m_buffer(),
+ m_pos(0),
+ m_offset(0),
+ m_line(1),
+ m_column(1),
+ m_end(false),
+ m_error()
+{
+};
+
+/*
+reader_position moves line and column (both start at 1) over len bytes of the text, so the reader keeps the position of the
+start of its buffer when the parsed part of the buffer is erased.
+*/
+static void reader_position(const char* p, size_t len, size_t& line, size_t& column)
+{
+ const char* end=p+len;
+ for(const char* q; (q=(const char*) memchr(p, '\n', end-p)) != NULL; p=q+1) { ++line; column=1; }
+ column+=(end-p);
+};
+
+bool zJSON::zReaderJSON::fill()
+{
+ if(m_pos && m_pos >= m_buffer.size()/2)
+ {
+  reader_position(m_buffer.data(), m_pos, m_line, m_column);
+  m_buffer.erase(0, m_pos);
+  m_offset+=m_pos;
+  m_pos=0;
+ }
+ size_t want=std::max(m_block, m_buffer.size()-m_pos), len=m_buffer.size(), got=0;
+ m_buffer.resize(len+want);
+ while(got < want)
+ {
+  long n=m_src.read(&m_buffer[len+got], want-got);
+  if(n < 0) { m_buffer.resize(len+got); return false; }
+  if(n == 0) { m_end=true; break; }
+  got+=(size_t) n;
+ }
+ m_buffer.resize(len+got);
+ return true;
+};
+
+/*
+reader_continued returns true if the text at pos after the parsed value may still continue the value when more text is read:
+the string which is not terminated yet and is concatenated to the string value, or '/' at the end of the buffer which may
+start the comment between the value and the next part of it.
+*/
+static bool reader_continued(const zJSON* p_json, const char* p, size_t len, size_t pos)
+{
+ if(p[pos] == '/' && (pos+1) == len) return true;
+ return (p[pos] == '\"' && p_json->type() == zJSON::JSON_STRING);
+};
+
+zJSON* zJSON::zReaderJSON::next()
+{
+ zJSON::zErrorJSON err;
+ return next(err);
+};
+
+zJSON* zJSON::zReaderJSON::next(zJSON::zErrorJSON& err)
+{
+ err=m_error;
+ if(err.code != zJSON::zErrorJSON::ERROR_NONE) return NULL;
+ for(;;)
+ {
+  size_t pos=m_pos, res_pos=0;
+  if(zJSON::scan_blank(m_buffer.data(), m_buffer.size(), pos))
+  {
+   const char* p=m_buffer.data()+pos;
+   size_t len=m_buffer.size()-pos;
+   zJSON* ret=zJSON::parse(p, len, 0, res_pos, err, m_opt);
+   if(ret)
+   {
+    size_t l=res_pos;
+    if(m_end || (zJSON::scan_blank(p, len, l) && !reader_continued(ret, p, len, l))) { m_pos=pos+res_pos; return ret; }
+    delete ret;
+   }
+   else if(m_end || err.code != zJSON::zErrorJSON::ERROR_EOF)
+   {
+    size_t line=m_line, column=m_column;
+    reader_position(m_buffer.data(), pos, line, column);
+    if(err.line == 1) err.column+=column-1;
+    err.line+=line-1;
+    err.offset+=m_offset+pos;
+    m_error=err;
+    return NULL;
+   }
+   err.clear();
+  }
+  else if(m_end) { m_pos=m_buffer.size(); return NULL; }
+  if(!fill())
+  {
+   err.code=zJSON::zErrorJSON::ERROR_READ;
+   err.offset=m_offset+m_buffer.size();
+   err.line=m_line;
+   err.column=m_column;
+   reader_position(m_buffer.data(), m_buffer.size(), err.line, err.column);
+   m_error=err;
+   return NULL;
+  }
+ }
+};
@@ -0,0 +1,508 @@
+/*
+Copyright (C) Alexander Zavesov
+Copyright (C) ZET-JSON
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "zJSON.h"
+
+#if defined(ZJSON_ZLIB) || defined(ZJSON_ZSTD)
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef ZJSON_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ZJSON_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+Compressed input and output: the caller and the worker thread exchange blocks of text through the queue of two blocks. The
+compressing worker takes the blocks written by the serializer, compresses them and writes the result to the destination sink,
+the decompressing worker reads the source, decompresses it and queues the blocks for the reader.
+*/
+
+static const size_t __zip_chunk__ = 65536;
+static const size_t __zip_queue__ = 2;
+
+class zjson_zip_output
+{
+ public:
+  virtual ~zjson_zip_output() {};
+  virtual bool put(const char* data, size_t len)=0;
+};
+
+class zjson_codec
+{
+ public:
+  zjson_codec(): m_buffer(__zip_chunk__, '\0') {};
+  virtual ~zjson_codec() {};
+  virtual bool run(const char* data, size_t len, bool end, zjson_zip_output& out)=0;
+
+ protected:
+  std::string m_buffer;
+};
+
+class zjson_plain_codec: public zjson_codec
+{
+ public:
+  virtual bool run(const char* data, size_t len, bool end, zjson_zip_output& out) { return (len == 0 || out.put(data, len)); };
+};
+
+#ifdef ZJSON_ZLIB
+class zjson_gzip_codec: public zjson_codec
+{
+ public:
+  zjson_gzip_codec(bool compress, int level): m_compress(compress), m_ready(false), m_done(false)
+  {
+   memset(&m_z, 0, sizeof(m_z));
+   if(m_compress) m_ready=(deflateInit2(&m_z, (level < 0)?(Z_DEFAULT_COMPRESSION):(level), Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+   else m_ready=(inflateInit2(&m_z, 15+32) == Z_OK);
+  };
+  virtual ~zjson_gzip_codec()
+  {
+   if(!m_ready) return;
+   if(m_compress) deflateEnd(&m_z);
+   else inflateEnd(&m_z);
+  };
+  virtual bool run(const char* data, size_t len, bool end, zjson_zip_output& out);
+
+ private:
+  z_stream m_z;
+  bool m_compress;
+  bool m_ready;
+  bool m_done;
+};
+
+bool zjson_gzip_codec::run(const char* data, size_t len, bool end, zjson_zip_output& out)
+{
+ if(!m_ready) return false;
+ if(!m_compress && m_done && len)
+ {
+  if(inflateReset(&m_z) != Z_OK) return false;
+  m_done=false;
+ }
+ m_z.next_in=(Bytef*) data;
+ m_z.avail_in=(uInt) len;
+ for(;;)
+ {
+  m_z.next_out=(Bytef*) &m_buffer[0];
+  m_z.avail_out=(uInt) m_buffer.size();
+  int r;
+  if(m_compress) r=deflate(&m_z, (end)?(Z_FINISH):(Z_NO_FLUSH));
+  else
+  {
+   r=inflate(&m_z, Z_NO_FLUSH);
+   if(r == Z_STREAM_END)
+   {
+    m_done=true;
+    if(m_z.avail_in)
+    {
+     if(inflateReset(&m_z) != Z_OK) return false;
+     m_done=false;
+    }
+    r=Z_OK;
+   }
+  }
+  if(r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) return false;
+  size_t n=m_buffer.size()-m_z.avail_out;
+  if(n && !out.put(m_buffer.data(), n)) return false;
+  if(m_compress && end) { if(r == Z_STREAM_END) return true; continue; }
+  if(m_z.avail_in == 0 && m_z.avail_out != 0) return (!end || m_done);
+ }
+};
+#endif
+
+#ifdef ZJSON_ZSTD
+class zjson_zstd_codec: public zjson_codec
+{
+ public:
+  zjson_zstd_codec(bool compress, int level): m_compress(compress), m_cctx(NULL), m_dctx(NULL), m_done(true)
+  {
+   if(m_compress)
+   {
+    m_cctx=ZSTD_createCCtx();
+    if(m_cctx) ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, (level < 0)?(ZSTD_CLEVEL_DEFAULT):(level));
+   }
+   else m_dctx=ZSTD_createDCtx();
+  };
+  virtual ~zjson_zstd_codec()
+  {
+   if(m_cctx) ZSTD_freeCCtx(m_cctx);
+   if(m_dctx) ZSTD_freeDCtx(m_dctx);
+  };
+  virtual bool run(const char* data, size_t len, bool end, zjson_zip_output& out);
+
+ private:
+  bool m_compress;
+  ZSTD_CCtx* m_cctx;
+  ZSTD_DCtx* m_dctx;
+  bool m_done;
+};
+
+bool zjson_zstd_codec::run(const char* data, size_t len, bool end, zjson_zip_output& out)
+{
+ if(m_cctx == NULL && m_dctx == NULL) return false;
+ ZSTD_inBuffer in;
+ in.src=data;
+ in.size=len;
+ in.pos=0;
+ for(;;)
+ {
+  ZSTD_outBuffer o;
+  o.dst=&m_buffer[0];
+  o.size=m_buffer.size();
+  o.pos=0;
+  size_t r, pos=in.pos;
+  if(m_compress) r=ZSTD_compressStream2(m_cctx, &o, &in, (end)?(ZSTD_e_end):(ZSTD_e_continue));
+  else r=ZSTD_decompressStream(m_dctx, &o, &in);
+  if(ZSTD_isError(r)) return false;
+  if(o.pos && !out.put(m_buffer.data(), o.pos)) return false;
+  if(m_compress)
+  {
+   if((end)?(r == 0):(in.pos == in.size)) return true;
+   continue;
+  }
+  if(in.pos != pos || o.pos) m_done=(r == 0);
+  if(in.pos == in.size && o.pos < o.size) return (!end || m_done);
+ }
+};
+#endif
+
+class zjson_zip_job
+{
+ public:
+  zjson_zip_job(): m_queue(), m_closed(false), m_stopped(false), m_failed(false), m_started(false)
+  {
+#ifdef _WIN32
+   InitializeCriticalSection(&m_lock);
+   InitializeConditionVariable(&m_cond);
+#else
+   pthread_mutex_init(&m_lock, NULL);
+   pthread_cond_init(&m_cond, NULL);
+#endif
+  };
+  virtual ~zjson_zip_job()
+  {
+#ifdef _WIN32
+   DeleteCriticalSection(&m_lock);
+#else
+   pthread_cond_destroy(&m_cond);
+   pthread_mutex_destroy(&m_lock);
+#endif
+  };
+
+  virtual void run()=0;
+  bool start();
+  void join();
+  bool push(std::string& block);
+  bool pop(std::string& block);
+  void close();
+  void stop();
+  void fail();
+  bool failed();
+
+ private:
+  std::deque<std::string> m_queue;
+  bool m_closed;
+  bool m_stopped;
+  bool m_failed;
+  bool m_started;
+#ifdef _WIN32
+  CRITICAL_SECTION m_lock;
+  CONDITION_VARIABLE m_cond;
+  HANDLE m_thread;
+
+  void lock() { EnterCriticalSection(&m_lock); };
+  void unlock() { LeaveCriticalSection(&m_lock); };
+  void wait() { SleepConditionVariableCS(&m_cond, &m_lock, INFINITE); };
+  void notify() { WakeAllConditionVariable(&m_cond); };
+  static DWORD WINAPI thread(LPVOID arg) { static_cast<zjson_zip_job*>(arg)->run(); return 0; };
+#else
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_cond;
+  pthread_t m_thread;
+
+  void lock() { pthread_mutex_lock(&m_lock); };
+  void unlock() { pthread_mutex_unlock(&m_lock); };
+  void wait() { pthread_cond_wait(&m_cond, &m_lock); };
+  void notify() { pthread_cond_broadcast(&m_cond); };
+  static void* thread(void* arg) { static_cast<zjson_zip_job*>(arg)->run(); return NULL; };
+#endif
+};
+
+bool zjson_zip_job::start()
+{
+#ifdef _WIN32
+ m_thread=CreateThread(NULL, 0, zjson_zip_job::thread, this, 0, NULL);
+ m_started=(m_thread != NULL);
+#else
+ m_started=(pthread_create(&m_thread, NULL, zjson_zip_job::thread, this) == 0);
+#endif
+ return m_started;
+};
+
+void zjson_zip_job::join()
+{
+ if(!m_started) return;
+#ifdef _WIN32
+ WaitForSingleObject(m_thread, INFINITE);
+ CloseHandle(m_thread);
+#else
+ pthread_join(m_thread, NULL);
+#endif
+ m_started=false;
+};
+
+bool zjson_zip_job::push(std::string& block)
+{
+ lock();
+ while(m_queue.size() >= __zip_queue__ && !m_stopped) wait();
+ bool ret=!m_stopped;
+ if(ret)
+ {
+  m_queue.push_back(std::string());
+  m_queue.back().swap(block);
+  notify();
+ }
+ unlock();
+ block.clear();
+ return ret;
+};
+
+bool zjson_zip_job::pop(std::string& block)
+{
+ lock();
+ while(m_queue.empty() && !m_closed && !m_stopped) wait();
+ bool ret=(!m_queue.empty() && !m_stopped);
+ if(ret)
+ {
+  block.swap(m_queue.front());
+  m_queue.pop_front();
+  notify();
+ }
+ unlock();
+ return ret;
+};
+
+void zjson_zip_job::close()
+{
+ lock();
+ m_closed=true;
+ notify();
+ unlock();
+};
+
+void zjson_zip_job::stop()
+{
+ lock();
+ m_stopped=true;
+ notify();
+ unlock();
+};
+
+void zjson_zip_job::fail()
+{
+ lock();
+ m_failed=true;
+ m_stopped=true;
+ notify();
+ unlock();
+};
+
+bool zjson_zip_job::failed()
+{
+ lock();
+ bool ret=m_failed;
+ unlock();
+ return ret;
+};
+
+static zjson_codec* zip_codec(int format, bool compress, int level)
+{
+#ifdef ZJSON_ZLIB
+ if(format == zJSON::COMPRESS_GZIP) return new zjson_gzip_codec(compress, level);
+#endif
+#ifdef ZJSON_ZSTD
+ if(format == zJSON::COMPRESS_ZSTD) return new zjson_zstd_codec(compress, level);
+#endif
+ return NULL;
+};
+
+class zjson_compress_job: public zjson_zip_job, public zjson_zip_output
+{
+ public:
+  zjson_compress_job(zJSON::zSinkJSON& dst, zjson_codec* codec): m_dst(dst), m_codec(codec) {};
+  virtual ~zjson_compress_job() { delete m_codec; };
+  virtual bool put(const char* data, size_t len) { return m_dst.write(data, len); };
+  virtual void run()
+  {
+   std::string block;
+   while(pop(block))
+   {
+    if(!m_codec->run(block.data(), block.size(), false, *this)) { fail(); return; }
+   }
+   if(!failed() && !m_codec->run(NULL, 0, true, *this)) fail();
+  };
+
+ private:
+  zJSON::zSinkJSON& m_dst;
+  zjson_codec* m_codec;
+};
+
+class zjson_decompress_job: public zjson_zip_job, public zjson_zip_output
+{
+ public:
+  zjson_decompress_job(zJSON::zSourceJSON& src, size_t block_size): m_src(src), m_block_size(block_size), m_block() {};
+  virtual bool put(const char* data, size_t len)
+  {
+   m_block.append(data, len);
+   return (m_block.size() < m_block_size || push(m_block));
+  };
+  virtual void run()
+  {
+   if(!decompress()) fail();
+   close();
+  };
+
+ private:
+  zJSON::zSourceJSON& m_src;
+  size_t m_block_size;
+  std::string m_block;
+
+  bool decompress();
+};
+
+bool zjson_decompress_job::decompress()
+{
+ std::string in(__zip_chunk__, '\0');
+ size_t len=0;
+ bool end=false;
+ while(len < 4 && !end)
+ {
+  long n=m_src.read(&in[len], in.size()-len);
+  if(n < 0) return false;
+  if(n == 0) end=true;
+  len+=(size_t) n;
+ }
+ const unsigned char* p=(const unsigned char*) in.data();
+ zjson_codec* codec;
+ if(len >= 2 && p[0] == 0x1F && p[1] == 0x8B) codec=zip_codec(zJSON::COMPRESS_GZIP, false, -1);
+ else if(len >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F && p[3] == 0xFD) codec=zip_codec(zJSON::COMPRESS_ZSTD, false, -1);
+ else codec= new zjson_plain_codec;
+ if(codec == NULL) return false;
+ bool ret=true;
+ for(;;)
+ {
+  if(!codec->run(in.data(), len, end, *this)) { ret=false; break; }
+  if(end) break;
+  long n=m_src.read(&in[0], in.size());
+  if(n < 0) { ret=false; break; }
+  len=(size_t) n;
+  end=(n == 0);
+ }
+ delete codec;
+ return (ret && (m_block.empty() || push(m_block)));
+};
+
+zJSON::zCompressSinkJSON::zCompressSinkJSON(zJSON::zSinkJSON& dst, int format, int level, size_t block_size):
+ m_pipe(NULL),
+ m_block(),
+ m_block_size((block_size)?(block_size):(1)),
+ m_failed(false)
+{
+ zjson_codec* codec=zip_codec(format, true, level);
+ if(codec == NULL) { m_failed=true; return; }
+ zjson_compress_job* job= new zjson_compress_job(dst, codec);
+ if(!job->start()) { delete job; m_failed=true; return; }
+ m_pipe=job;
+ m_block.reserve(m_block_size);
+};
+
+zJSON::zCompressSinkJSON::~zCompressSinkJSON() { close(); };
+
+bool zJSON::zCompressSinkJSON::write(const char* data, size_t len)
+{
+ if(m_pipe == NULL || m_failed) return false;
+ m_block.append(data, len);
+ if(m_block.size() < m_block_size) return true;
+ if(!static_cast<zjson_compress_job*>(m_pipe)->push(m_block)) m_failed=true;
+ m_block.reserve(m_block_size);
+ return !m_failed;
+};
+
+bool zJSON::zCompressSinkJSON::close()
+{
+ zjson_compress_job* job=static_cast<zjson_compress_job*>(m_pipe);
+ if(job == NULL) return !m_failed;
+ if(!m_failed && m_block.size() && !job->push(m_block)) m_failed=true;
+ job->close();
+ job->join();
+ if(job->failed()) m_failed=true;
+ delete job;
+ m_pipe=NULL;
+ std::string().swap(m_block);
+ return !m_failed;
+};
+
+zJSON::zDecompressSourceJSON::zDecompressSourceJSON(zJSON::zSourceJSON& src, size_t block_size):
+ m_pipe(NULL),
+ m_block(),
+ m_block_size((block_size)?(block_size):(1)),
+ m_pos(0),
+ m_state(0)
+{
+ zjson_decompress_job* job= new zjson_decompress_job(src, m_block_size);
+ if(!job->start()) { delete job; m_state=-1; return; }
+ m_pipe=job;
+};
+
+zJSON::zDecompressSourceJSON::~zDecompressSourceJSON()
+{
+ zjson_decompress_job* job=static_cast<zjson_decompress_job*>(m_pipe);
+ if(job == NULL) return;
+ job->stop();
+ job->join();
+ delete job;
+};
+
+long zJSON::zDecompressSourceJSON::read(char* data, size_t len)
+{
+ while(m_pos == m_block.size())
+ {
+  if(m_state) return (m_state < 0)?(-1):(0);
+  zjson_decompress_job* job=static_cast<zjson_decompress_job*>(m_pipe);
+  m_block.clear();
+  m_pos=0;
+  if(!job->pop(m_block)) m_state=(job->failed())?(-1):(1);
+ }
+ size_t n=std::min(len, m_block.size()-m_pos);
+ if(n > 0x40000000) n=0x40000000;
+ memcpy(data, m_block.data()+m_pos, n);
+ m_pos+=n;
+ return (long) n;
+};
+
+#endif